@@ -315,8 +315,20 @@ int stringCmp( const void *a, const void *b)
 SOATTR int aml_init( int *argc, char ***argv ) {
 	int r, i, j,tmpmax;
 
+#ifdef AML_MPI_THREAD_FUNNELED
+	// for hybrid builds: OpenMP threads run between AML calls, but only the
+	// master thread calls MPI
+	int provided;
+	r = MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+	if ( r != MPI_SUCCESS ) return r;
+	if ( provided < MPI_THREAD_FUNNELED ) {
+		printf("AML: Fatal: MPI does not provide MPI_THREAD_FUNNELED.\n");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+#else
 	r = MPI_Init(argc, argv);
 	if ( r != MPI_SUCCESS ) return r;
+#endif
 
 	MPI_Comm_size( MPI_COMM_WORLD, &num_procs );
 	MPI_Comm_rank( MPI_COMM_WORLD, &myproc );
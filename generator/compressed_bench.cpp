@@ -0,0 +1,138 @@
+/* Throughput benchmark for the compressed edge format (compressed_edges.h).
+ *
+ * Usage: compressed_bench file.cbin [file.bin]
+ *
+ * Decodes every block of the compressed file in parallel and reports the
+ * compression ratio, decode throughput and random-access latency.  If the
+ * matching 64-bit binary file (generator_omp -f 1 with the same arguments
+ * and -s) is given, it is read with the same parallelism for comparison and
+ * every decoded block is checked against it. */
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "fmt/format.h"
+
+#include "compressed_edges.h"
+
+using namespace std;
+
+[[noreturn]] static void fail(const char* what) {
+    cout << what << " failed." << endl;
+    cout << std::strerror(errno) << endl;
+    exit(errno ? errno : 1);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2 || argc > 3) {
+        cout << "Usage: " << argv[0] << " file.cbin [file.bin]" << endl;
+        return 1;
+    }
+
+    cedges_file f;
+    if(cedges_open(argv[1], &f) == -1) fail("open");
+    struct stat st;
+    fstat(f.fd, &st);
+    double bytes_per_edge = f.nedges ? static_cast<double>(st.st_size) / f.nedges : 0;
+    cout << fmt::format("{} edges in {} blocks, {} bytes ({:.3f} bytes/edge, {:.2f}x smaller than 64-bit binary)",
+                        f.nedges, f.nblocks, st.st_size, bytes_per_edge, 16 / bytes_per_edge) << endl;
+
+    /* Full parallel decode. */
+    uint64_t checksum = 0;
+    double time_taken = omp_get_wtime();
+    #pragma omp parallel reduction(+:checksum)
+    {
+        vector<int64_t> edges(2 * CEDGES_BLOCK_EDGES);
+        vector<uint8_t> scratch(f.max_block_bytes);
+        #pragma omp for schedule(dynamic, 1)
+        for(int64_t b = 0; b < f.nblocks; b++) {
+            int64_t n = cedges_read_block(&f, b, edges.data(), scratch.data());
+            if(n < 0) fail("decode");
+            for(int64_t i = 0; i < 2 * n; i++) checksum += edges[i];
+        }
+    }
+    time_taken = omp_get_wtime() - time_taken;
+    cout << fmt::format("decode: {:.3f}s, {:.2f} Medges/s, {:.2f} GB/s of 64-bit edges, {:.2f} GB/s from disk (checksum {})",
+                        time_taken, 1e-6 * f.nedges / time_taken, 16e-9 * f.nedges / time_taken,
+                        1e-9 * st.st_size / time_taken, checksum) << endl;
+
+    /* Random access: find and decode the block holding a random edge. */
+    if(f.nedges > 0) {
+        const int nlookups = 1000;
+        mt19937_64 rng(1);
+        vector<int64_t> edges(2 * CEDGES_BLOCK_EDGES);
+        vector<uint8_t> scratch(f.max_block_bytes);
+        time_taken = omp_get_wtime();
+        for(int i = 0; i < nlookups; i++) {
+            int64_t b = cedges_find_block(&f, rng() % f.nedges);
+            if(cedges_read_block(&f, b, edges.data(), scratch.data()) < 0) fail("decode");
+        }
+        time_taken = omp_get_wtime() - time_taken;
+        cout << fmt::format("random block access: {:.1f} us per lookup", 1e6 * time_taken / nlookups) << endl;
+    }
+
+    if(argc == 3) {
+        int fd = open(argv[2], O_RDONLY);
+        if(fd == -1) fail("open");
+        struct stat raw_st;
+        fstat(fd, &raw_st);
+        if(raw_st.st_size != 16 * f.nedges) {
+            cout << "binary file does not match: expected 64-bit vertex IDs and " << f.nedges << " edges." << endl;
+            return 1;
+        }
+
+        /* Plain parallel read of the same edges, for comparison. */
+        uint64_t raw_checksum = 0;
+        time_taken = omp_get_wtime();
+        #pragma omp parallel reduction(+:raw_checksum)
+        {
+            vector<array<int64_t, 2>> raw(CEDGES_BLOCK_EDGES);
+            #pragma omp for schedule(dynamic, 1)
+            for(int64_t b = 0; b < f.nblocks; b++) {
+                int64_t n = f.first_edges[b + 1] - f.first_edges[b];
+                size_t len = n * sizeof(raw[0]);
+                if(pread(fd, raw.data(), len, f.first_edges[b] * sizeof(raw[0])) != static_cast<ssize_t>(len)) fail("read");
+                for(int64_t i = 0; i < n; i++) raw_checksum += raw[i][0] + raw[i][1];
+            }
+        }
+        time_taken = omp_get_wtime() - time_taken;
+        cout << fmt::format("binary read: {:.3f}s, {:.2f} Medges/s, {:.2f} GB/s from disk (checksum {})",
+                            time_taken, 1e-6 * f.nedges / time_taken, 16e-9 * f.nedges / time_taken, raw_checksum) << endl;
+
+        int64_t mismatches = 0;
+        #pragma omp parallel reduction(+:mismatches)
+        {
+            vector<array<int64_t, 2>> raw(CEDGES_BLOCK_EDGES);
+            vector<int64_t> edges(2 * CEDGES_BLOCK_EDGES);
+            vector<uint8_t> scratch(f.max_block_bytes);
+            #pragma omp for schedule(dynamic, 1)
+            for(int64_t b = 0; b < f.nblocks; b++) {
+                int64_t n = f.first_edges[b + 1] - f.first_edges[b];
+                size_t len = n * sizeof(raw[0]);
+                if(pread(fd, raw.data(), len, f.first_edges[b] * sizeof(raw[0])) != static_cast<ssize_t>(len)) fail("read");
+                sort(raw.begin(), raw.begin() + n);
+                if(cedges_read_block(&f, b, edges.data(), scratch.data()) != n ||
+                   memcmp(raw.data(), edges.data(), len) != 0) {
+                    mismatches++;
+                }
+            }
+        }
+        close(fd);
+        cout << fmt::format("verify: {} of {} blocks differ from the binary file", mismatches, f.nblocks) << endl;
+        if(mismatches) return 1;
+    }
+
+    cedges_close(&f);
+    return 0;
+}
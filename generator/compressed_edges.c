@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "compressed_edges.h"
+
+static inline uint8_t* put_varint(uint8_t* p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+/* Returns NULL if the varint runs past end. */
+static inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint64_t* v) {
+  uint64_t x = 0;
+  int shift = 0;
+  while (p < end) {
+    uint8_t b = *p++;
+    x |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = x;
+      return p;
+    }
+    shift += 7;
+  }
+  return NULL;
+}
+
+size_t cedges_max_encoded_size(size_t nedges) {
+  return 10 + 20 * nedges; /* At most 10 bytes per varint */
+}
+
+size_t cedges_encode_block(const int64_t* edges, size_t nedges, uint8_t* out) {
+  uint8_t* p = put_varint(out, nedges);
+  uint64_t prev_v0 = 0, prev_v1 = 0;
+  size_t i;
+  for (i = 0; i < nedges; ++i) {
+    uint64_t v0 = (uint64_t)edges[2 * i];
+    uint64_t v1 = (uint64_t)edges[2 * i + 1];
+    p = put_varint(p, v0 - prev_v0);
+    p = put_varint(p, (i > 0 && v0 == prev_v0) ? v1 - prev_v1 : v1);
+    prev_v0 = v0;
+    prev_v1 = v1;
+  }
+  return (size_t)(p - out);
+}
+
+int64_t cedges_decode_block(const uint8_t* in, size_t nbytes, int64_t* edges, size_t capacity) {
+  const uint8_t* end = in + nbytes;
+  uint64_t nedges, d0, d1;
+  in = get_varint(in, end, &nedges);
+  if (!in || nedges > capacity) return -1;
+  uint64_t v0 = 0, v1 = 0;
+  uint64_t i;
+  for (i = 0; i < nedges; ++i) {
+    if (!(in = get_varint(in, end, &d0))) return -1;
+    if (!(in = get_varint(in, end, &d1))) return -1;
+    v1 = (i > 0 && d0 == 0) ? v1 + d1 : d1;
+    v0 += d0;
+    edges[2 * i] = (int64_t)v0;
+    edges[2 * i + 1] = (int64_t)v1;
+  }
+  return (int64_t)nedges;
+}
+
+static int pread_all(int fd, void* buf, size_t len, off_t off) {
+  char* p = (char*)buf;
+  while (len > 0) {
+    ssize_t n = pread(fd, p, len, off);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) {
+      if (n == 0) errno = EINVAL; /* Truncated file */
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+    off += n;
+  }
+  return 0;
+}
+
+int cedges_open(const char* path, cedges_file* f) {
+  cedges_trailer t;
+  struct stat st;
+  f->offsets = f->first_edges = NULL;
+  f->fd = open(path, O_RDONLY);
+  if (f->fd == -1) return -1;
+  if (fstat(f->fd, &st) == -1) goto fail;
+  if ((size_t)st.st_size < sizeof(t)) {
+    errno = EINVAL;
+    goto fail;
+  }
+  if (pread_all(f->fd, &t, sizeof(t), st.st_size - sizeof(t))) goto fail;
+  if (t.magic != CEDGES_MAGIC ||
+      t.index_offset + 2 * (t.nblocks + 1) * sizeof(uint64_t) + sizeof(t) != (uint64_t)st.st_size) {
+    errno = EINVAL;
+    goto fail;
+  }
+  f->nedges = (int64_t)t.nedges;
+  f->nblocks = (int64_t)t.nblocks;
+  f->offsets = (uint64_t*)malloc((t.nblocks + 1) * sizeof(uint64_t));
+  f->first_edges = (uint64_t*)malloc((t.nblocks + 1) * sizeof(uint64_t));
+  if (!f->offsets || !f->first_edges) {
+    errno = ENOMEM;
+    goto fail;
+  }
+  if (pread_all(f->fd, f->offsets, (t.nblocks + 1) * sizeof(uint64_t), t.index_offset)) goto fail;
+  if (pread_all(f->fd, f->first_edges, (t.nblocks + 1) * sizeof(uint64_t), t.index_offset + (t.nblocks + 1) * sizeof(uint64_t))) goto fail;
+  /* Blocks must tile [0, index_offset) and [0, nedges) in order, with at
+   * most CEDGES_BLOCK_EDGES edges each, so callers can size their buffers. */
+  if (f->offsets[0] != 0 || f->offsets[t.nblocks] != t.index_offset ||
+      f->first_edges[0] != 0 || f->first_edges[t.nblocks] != t.nedges) {
+    errno = EINVAL;
+    goto fail;
+  }
+  f->max_block_bytes = 0;
+  int64_t i;
+  for (i = 0; i < f->nblocks; ++i) {
+    if (f->offsets[i + 1] < f->offsets[i] || f->first_edges[i + 1] < f->first_edges[i] ||
+        f->first_edges[i + 1] - f->first_edges[i] > CEDGES_BLOCK_EDGES) {
+      errno = EINVAL;
+      goto fail;
+    }
+    size_t len = f->offsets[i + 1] - f->offsets[i];
+    if (len > f->max_block_bytes) f->max_block_bytes = len;
+  }
+  return 0;
+
+fail:
+  {
+    int err = errno;
+    cedges_close(f);
+    errno = err;
+  }
+  return -1;
+}
+
+void cedges_close(cedges_file* f) {
+  if (f->fd != -1) close(f->fd);
+  free(f->offsets);
+  free(f->first_edges);
+  f->fd = -1;
+  f->offsets = f->first_edges = NULL;
+}
+
+int64_t cedges_find_block(const cedges_file* f, int64_t edge) {
+  int64_t lo = 0, hi = f->nblocks; /* first_edges[lo] <= edge < first_edges[hi] */
+  while (hi - lo > 1) {
+    int64_t mid = lo + (hi - lo) / 2;
+    if ((int64_t)f->first_edges[mid] <= edge) lo = mid; else hi = mid;
+  }
+  return lo;
+}
+
+int64_t cedges_read_block(const cedges_file* f, int64_t block, int64_t* edges, uint8_t* scratch) {
+  if (block < 0 || block >= f->nblocks || f->offsets[block + 1] < f->offsets[block] ||
+      f->offsets[block + 1] - f->offsets[block] > f->max_block_bytes) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t len = f->offsets[block + 1] - f->offsets[block];
+  size_t expected = f->first_edges[block + 1] - f->first_edges[block];
+  if (pread_all(f->fd, scratch, len, (off_t)f->offsets[block])) return -1;
+  int64_t n = cedges_decode_block(scratch, len, edges, expected);
+  if (n != (int64_t)expected) {
+    errno = EINVAL;
+    return -1;
+  }
+  return n;
+}
@@ -0,0 +1,79 @@
+#ifndef COMPRESSED_EDGES_H
+#define COMPRESSED_EDGES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Compressed edge list format ('cbin' files written by generator_omp -f 4).
+ *
+ * The file is a sequence of independently decodable blocks of at most
+ * CEDGES_BLOCK_EDGES edges, followed by an index and a trailer:
+ *
+ *   block 0 | block 1 | ... | uint64_t offsets[nblocks + 1]
+ *                           | uint64_t first_edges[nblocks + 1]
+ *                           | cedges_trailer
+ *
+ * offsets[i] is the byte offset of block i and first_edges[i] the index of
+ * its first edge in the file; the last entries are index_offset and nedges.
+ * A block holds the edges of its range sorted by (v0, v1), so the edge order
+ * inside a block is not preserved.  It starts with its edge count as a
+ * varint, then for each edge the varint delta of v0 from the previous edge
+ * (from 0 for the first), followed by the varint delta of v1 from the previous
+ * edge when v0 repeats, or v1 itself otherwise.  Varints are unsigned LEB128
+ * and all fixed-size integers are native-endian. */
+
+#define CEDGES_BLOCK_EDGES ((size_t)1 << 16)
+#define CEDGES_MAGIC UINT64_C(0x31504d434e4f524b) /* "KRONCMP1" */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cedges_trailer {
+  uint64_t nedges;       /* Edges in the file */
+  uint64_t nblocks;      /* Compressed blocks in the file */
+  uint64_t index_offset; /* Byte offset of the offsets array */
+  uint64_t magic;        /* CEDGES_MAGIC */
+} cedges_trailer;
+
+typedef struct cedges_file {
+  int fd;
+  int64_t nedges;
+  int64_t nblocks;
+  uint64_t* offsets;     /* nblocks + 1 entries */
+  uint64_t* first_edges; /* nblocks + 1 entries */
+  size_t max_block_bytes; /* Scratch size needed by cedges_read_block */
+} cedges_file;
+
+/* Upper bound on the encoded size of a block of nedges edges. */
+size_t cedges_max_encoded_size(size_t nedges);
+
+/* Encode nedges edges given as (v0, v1) pairs, which must be sorted by
+ * (v0, v1) with non-negative ids; returns the number of bytes written. */
+size_t cedges_encode_block(const int64_t* edges, size_t nedges, uint8_t* out);
+
+/* Decode a block into (v0, v1) pairs, edges having room for capacity pairs;
+ * returns the number of edges, or -1 if the block is truncated or holds more
+ * than capacity edges. */
+int64_t cedges_decode_block(const uint8_t* in, size_t nbytes, int64_t* edges, size_t capacity);
+
+/* Open a compressed file and load its index; returns 0, or -1 with errno set
+ * (EINVAL for a file that is not in this format or whose index is
+ * inconsistent, e.g. a block of more than CEDGES_BLOCK_EDGES edges). */
+int cedges_open(const char* path, cedges_file* f);
+void cedges_close(cedges_file* f);
+
+/* Block containing edge number edge (in [0, nedges)). */
+int64_t cedges_find_block(const cedges_file* f, int64_t edge);
+
+/* Read and decode block number block into edges, which must hold
+ * first_edges[block + 1] - first_edges[block] pairs; scratch must hold
+ * max_block_bytes bytes.  Uses pread, so blocks can be decoded concurrently.
+ * Returns the number of edges, or -1 with errno set. */
+int64_t cedges_read_block(const cedges_file* f, int64_t block, int64_t* edges, uint8_t* scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPRESSED_EDGES_H */
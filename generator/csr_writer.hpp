@@ -0,0 +1,210 @@
+#ifndef CSR_WRITER_HPP
+#define CSR_WRITER_HPP
+
+/* Builds a CSR file set directly from generated edge blocks:
+ *   {2} = "offsets":   uint64_t[nverts + 1], row i is [offsets[i], offsets[i+1])
+ *   {2} = "neighbors": int64_t (uint32_t with short_ids) [offsets[nverts]],
+ *                      sorted within each row
+ *   {2} = "weights":   with weights, float or 16-bit (see quantize_weight)
+ *                      [offsets[nverts]], the SSSP weight of each neighbor
+ * Like convert_graph_to_oned_csr, every undirected edge (u, v) is stored as
+ * u -> v and v -> u, self loops are dropped and duplicates are kept.
+ *
+ * Each block is expanded to directed entries and sorted by a parallel
+ * counting sort on the high bits of the source followed by a per-bucket
+ * sort.  A graph that fits in one block is written straight from memory;
+ * otherwise every block is spilled as a sorted run (external_merge.hpp) and
+ * the runs are k-way merged into the output, so only one block and a small
+ * buffer per run are ever in memory. */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <omp.h>
+
+#include "graph_generator.h"
+#include "external_merge.hpp"
+
+/* Weight as stored in a weights file: the float itself, or for 16-bit files
+ * w * 65535 rounded to nearest (weights are in [0, 1]). */
+template<typename WeightType>
+static inline WeightType quantize_weight(float w);
+
+template<>
+inline float quantize_weight<float>(float w) {
+    return w;
+}
+
+template<>
+inline uint16_t quantize_weight<uint16_t>(float w) {
+    return static_cast<uint16_t>(lrintf(std::min(w, 1.0f) * 65535.0f));
+}
+
+/* Expand edges to directed entries without self loops and sort them.  A
+ * weighted_csr_entry takes the weight of its edge from weights. */
+template<typename Entry>
+void csr_sort_block(const packed_edge* edges, const float* weights, size_t nedges, int log_numverts, std::vector<Entry>& out) {
+    int nthreads = omp_get_max_threads();
+    int log_nbuckets = 0;
+    while((1 << log_nbuckets) < 8 * nthreads && log_nbuckets < log_numverts) log_nbuckets++;
+    int shift = log_numverts - log_nbuckets;
+    size_t nbuckets = size_t(1) << log_nbuckets;
+
+    std::vector<size_t> offsets(nthreads * nbuckets, 0);
+    std::vector<size_t> bucket_start(nbuckets + 1);
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        size_t* off = &offsets[tid * nbuckets];
+
+        #pragma omp for schedule(static)
+        for(size_t i=0; i<nedges; i++) {
+            int64_t v0 = get_v0_from_edge(edges + i);
+            int64_t v1 = get_v1_from_edge(edges + i);
+            if(v0 == v1) continue;
+            off[v0 >> shift]++;
+            off[v1 >> shift]++;
+        }
+
+        #pragma omp single
+        {
+            int nt = omp_get_num_threads();
+            size_t pos = 0;
+            for(size_t b = 0; b < nbuckets; b++) {
+                bucket_start[b] = pos;
+                for(int t = 0; t < nt; t++) {
+                    size_t count = offsets[t * nbuckets + b];
+                    offsets[t * nbuckets + b] = pos;
+                    pos += count;
+                }
+            }
+            bucket_start[nbuckets] = pos;
+            out.resize(pos);
+        }
+
+        #pragma omp for schedule(static)
+        for(size_t i=0; i<nedges; i++) {
+            int64_t v0 = get_v0_from_edge(edges + i);
+            int64_t v1 = get_v1_from_edge(edges + i);
+            if(v0 == v1) continue;
+            if constexpr(std::is_same_v<Entry, weighted_csr_entry>) {
+                out[off[v0 >> shift]++] = {v0, v1, weights[i]};
+                out[off[v1 >> shift]++] = {v1, v0, weights[i]};
+            } else {
+                out[off[v0 >> shift]++] = {v0, v1};
+                out[off[v1 >> shift]++] = {v1, v0};
+            }
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for(size_t b = 0; b < nbuckets; b++) {
+            std::sort(out.begin() + bucket_start[b], out.begin() + bucket_start[b + 1]);
+        }
+    }
+}
+
+class csr_writer {
+public:
+    /* path(kind, 0) gives the file for "offsets", "neighbors" and "weights";
+     * weight_format is 0 (none), 1 (float) or 2 (16-bit). */
+    csr_writer(std::function<std::filesystem::path(const char*, int64_t)> path, int log_numverts, int64_t nblocks, bool short_ids, int weight_format)
+        : path(path), log_numverts(log_numverts), nblocks(nblocks), short_ids(short_ids), weight_format(weight_format),
+          runs(path("offsets", 0)), weighted_runs(path("offsets", 0)) {}
+
+    /* Blocks must be added in order; weights is only read with a
+     * weight_format. */
+    void add_block(const packed_edge* edges, const float* weights, size_t nedges) {
+        if(weight_format) {
+            add_block(edges, weights, nedges, weighted_runs, weighted_entries);
+        } else {
+            add_block(edges, weights, nedges, runs, entries);
+        }
+    }
+
+    /* Write offsets, neighbors and weights; returns the number of directed
+     * edges. */
+    uint64_t finish() {
+        std::filesystem::path offsets_path = path("offsets", 0);
+        if(offsets_path.has_parent_path()) std::filesystem::create_directories(offsets_path.parent_path());
+        csr_file offsets(offsets_path, "wb");
+        csr_file neighbors(path("neighbors", 0), "wb");
+        std::unique_ptr<csr_file> weights;
+        if(weight_format) weights.reset(new csr_file(path("weights", 0), "wb"));
+
+        int64_t next_vertex = 0;
+        uint64_t pos = 0;
+        auto put_entry = [&](int64_t src, int64_t dst) {
+            while(next_vertex <= src) {
+                offsets.put<uint64_t>(pos);
+                next_vertex++;
+            }
+            if(short_ids) {
+                neighbors.put<uint32_t>(static_cast<uint32_t>(dst));
+            } else {
+                neighbors.put<int64_t>(dst);
+            }
+            pos++;
+        };
+        auto emit = [&](const csr_entry& e) { put_entry(e.src, e.dst); };
+        auto emit_weighted = [&](const weighted_csr_entry& e) {
+            put_entry(e.src, e.dst);
+            if(weight_format == 1) {
+                weights->put<float>(quantize_weight<float>(e.weight));
+            } else {
+                weights->put<uint16_t>(quantize_weight<uint16_t>(e.weight));
+            }
+        };
+
+        if(weight_format) {
+            merge(weighted_runs, weighted_entries, emit_weighted);
+        } else {
+            merge(runs, entries, emit);
+        }
+
+        int64_t nverts = int64_t(1) << log_numverts;
+        while(next_vertex <= nverts) {
+            offsets.put<uint64_t>(pos);
+            next_vertex++;
+        }
+        return pos;
+    }
+
+private:
+    template<typename Entry>
+    void add_block(const packed_edge* edges, const float* weights, size_t nedges, sorted_runs<Entry>& runs, std::vector<Entry>& entries) {
+        csr_sort_block(edges, weights, nedges, log_numverts, entries);
+        if(nblocks > 1) {
+            runs.spill(entries);
+            entries.clear();
+            entries.shrink_to_fit();
+        }
+    }
+
+    template<typename Entry, typename Emit>
+    void merge(sorted_runs<Entry>& runs, std::vector<Entry>& entries, Emit& emit) {
+        if(nblocks <= 1) {
+            for(const Entry& e : entries) emit(e);
+        } else {
+            runs.merge(emit);
+        }
+    }
+
+    std::function<std::filesystem::path(const char*, int64_t)> path;
+    int log_numverts;
+    int64_t nblocks;
+    bool short_ids;
+    int weight_format;
+    sorted_runs<csr_entry> runs;
+    sorted_runs<weighted_csr_entry> weighted_runs;
+    std::vector<csr_entry> entries;
+    std::vector<weighted_csr_entry> weighted_entries;
+};
+
+#endif /* CSR_WRITER_HPP */
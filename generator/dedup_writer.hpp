@@ -0,0 +1,198 @@
+#ifndef DEDUP_WRITER_HPP
+#define DEDUP_WRITER_HPP
+
+/* Cleans generated edge blocks into a canonical edge list: every edge is
+ * stored once as (u, v) with u < v, self loops and duplicate undirected pairs
+ * are dropped, and the list is sorted by (u, v).
+ *
+ * Each block is canonicalized and sorted by a parallel LSD radix sort on the
+ * 2 * log_numverts key bits, then duplicates inside the block are removed.  A
+ * graph that fits in one block is emitted straight from memory; otherwise
+ * every block is spilled as a sorted run (external_merge.hpp) and the runs
+ * are k-way merged, dropping duplicates across blocks, so only one block and
+ * a small buffer per run are ever in memory. */
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include <omp.h>
+
+#include "graph_generator.h"
+#include "external_merge.hpp"
+
+struct dedup_stats {
+    uint64_t self_loops = 0;
+    uint64_t duplicates = 0;
+    uint64_t edges = 0;      /* Edges left */
+};
+
+/* Bits [shift, shift + bits) of the key (src << log_numverts) | dst. */
+static inline uint32_t dedup_key_digit(const csr_entry& e, int log_numverts, int shift, int bits) {
+    uint64_t src = static_cast<uint64_t>(e.src), dst = static_cast<uint64_t>(e.dst);
+    uint64_t d;
+    if(shift >= log_numverts) {
+        d = src >> (shift - log_numverts);
+    } else {
+        d = (dst >> shift) | (src << (log_numverts - shift));
+    }
+    return static_cast<uint32_t>(d & ((uint64_t(1) << bits) - 1));
+}
+
+/* Canonicalize edges to (min, max) without self loops, sort them with a
+ * parallel LSD radix sort and drop duplicates; out receives the result. */
+inline void dedup_sort_block(const packed_edge* edges, size_t nedges, int log_numverts, std::vector<csr_entry>& out, dedup_stats& stats) {
+    const int RADIX_BITS = 11;
+    const size_t nbuckets = size_t(1) << RADIX_BITS;
+    int nthreads = omp_get_max_threads();
+    std::vector<size_t> counts(static_cast<size_t>(nthreads) * nbuckets);
+    std::vector<csr_entry> tmp;
+    int key_bits = 2 * log_numverts;
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        size_t* cnt = &counts[static_cast<size_t>(tid) * nbuckets];
+
+        /* Canonicalize, keeping each thread's share contiguous. */
+        size_t begin = nedges * tid / nt, end = nedges * (tid + 1) / nt;
+        size_t kept = 0;
+        for(size_t i = begin; i < end; i++) {
+            kept += get_v0_from_edge(edges + i) != get_v1_from_edge(edges + i);
+        }
+        cnt[0] = kept;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t pos = 0;
+            for(int t = 0; t < nt; t++) {
+                size_t c = counts[static_cast<size_t>(t) * nbuckets];
+                counts[static_cast<size_t>(t) * nbuckets] = pos;
+                pos += c;
+            }
+            stats.self_loops += nedges - pos;
+            out.resize(pos);
+            tmp.resize(pos);
+        }
+        size_t pos = cnt[0];
+        for(size_t i = begin; i < end; i++) {
+            int64_t v0 = get_v0_from_edge(edges + i);
+            int64_t v1 = get_v1_from_edge(edges + i);
+            if(v0 == v1) continue;
+            out[pos++] = {std::min(v0, v1), std::max(v0, v1)};
+        }
+        #pragma omp barrier
+
+        /* Stable passes, least significant digit first: per-thread
+         * histograms, digit-major then thread-major offsets, scatter. */
+        size_t n = out.size();
+        begin = n * tid / nt;
+        end = n * (tid + 1) / nt;
+        std::vector<csr_entry>* src = &out;
+        std::vector<csr_entry>* dst = &tmp;
+        for(int shift = 0; shift < key_bits; shift += RADIX_BITS) {
+            int bits = std::min(RADIX_BITS, key_bits - shift);
+            std::fill(cnt, cnt + nbuckets, 0);
+            for(size_t i = begin; i < end; i++) {
+                cnt[dedup_key_digit((*src)[i], log_numverts, shift, bits)]++;
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                size_t p = 0;
+                for(size_t b = 0; b < nbuckets; b++) {
+                    for(int t = 0; t < nt; t++) {
+                        size_t c = counts[static_cast<size_t>(t) * nbuckets + b];
+                        counts[static_cast<size_t>(t) * nbuckets + b] = p;
+                        p += c;
+                    }
+                }
+            }
+            for(size_t i = begin; i < end; i++) {
+                const csr_entry& e = (*src)[i];
+                (*dst)[cnt[dedup_key_digit(e, log_numverts, shift, bits)]++] = e;
+            }
+            #pragma omp barrier
+            std::swap(src, dst);
+        }
+        #pragma omp single
+        {
+            if(src != &out) out.swap(tmp);
+        }
+    }
+
+    auto is_same = [](const csr_entry& a, const csr_entry& b) { return a.src == b.src && a.dst == b.dst; };
+    size_t n = std::unique(out.begin(), out.end(), is_same) - out.begin();
+    stats.duplicates += out.size() - n;
+    out.resize(n);
+}
+
+class dedup_writer {
+public:
+    /* Runs are spilled beside the file output. */
+    dedup_writer(const std::filesystem::path& output, int log_numverts, int64_t nblocks)
+        : log_numverts(log_numverts), nblocks(nblocks), runs(output) {}
+
+    void add_block(const packed_edge* edges, size_t nedges) {
+        input_edges += nedges;
+        dedup_sort_block(edges, nedges, log_numverts, entries, stats);
+        if(nblocks > 1) {
+            runs.spill(entries);
+            entries.clear();
+            entries.shrink_to_fit();
+        }
+    }
+
+    /* Pass the cleaned edges to sink in order, in pieces of at most
+     * piece_size edges; returns what was removed. */
+    dedup_stats finish(size_t piece_size, const std::function<void(packed_edge*, size_t)>& sink) {
+        std::vector<packed_edge> piece(std::max<size_t>(piece_size, 1));
+        size_t n = 0;
+        int64_t npieces = 0;
+        auto emit = [&](const csr_entry& e) {
+            write_edge(&piece[n], e.src, e.dst);
+            if(++n == piece.size()) {
+                sink(piece.data(), n);
+                npieces++;
+                n = 0;
+            }
+        };
+
+        if(nblocks <= 1) {
+            for(const csr_entry& e : entries) emit(e);
+            entries.clear();
+        } else {
+            /* Equal entries of different runs come out adjacent. */
+            bool have_last = false;
+            csr_entry last = {0, 0};
+            auto emit_unique = [&](const csr_entry& e) {
+                if(have_last && e.src == last.src && e.dst == last.dst) {
+                    stats.duplicates++;
+                    return;
+                }
+                emit(e);
+                last = e;
+                have_last = true;
+            };
+            runs.merge(emit_unique);
+        }
+        /* An empty graph still gets an (empty) file. */
+        if(n > 0 || npieces == 0) sink(piece.data(), n);
+
+        stats.edges = input_edges - stats.self_loops - stats.duplicates;
+        return stats;
+    }
+
+private:
+    int log_numverts;
+    int64_t nblocks;
+    uint64_t input_edges = 0;
+    dedup_stats stats;
+    sorted_runs<csr_entry> runs;
+    std::vector<csr_entry> entries;
+};
+
+#endif /* DEDUP_WRITER_HPP */
@@ -0,0 +1,221 @@
+#ifndef DEGREE_STATS_HPP
+#define DEGREE_STATS_HPP
+
+/* Streaming degree statistics of the generated graph, as kernel 1 sees it:
+ * every edge (u, v) with u != v adds one to the degree of u and of v, self
+ * loops are only counted, and duplicates are kept.
+ *
+ * Degrees are summed into one uint32_t per vertex.  With 16-bit counters
+ * every thread also has a private direct-mapped cache of at most
+ * CACHE_SLOTS saturating uint16_t counters, tagged with their vertex; a
+ * counter is added to the shared array atomically when it saturates or its
+ * slot is taken by another vertex, and the caches are flushed at the end.
+ * The hubs, which get most endpoints, stay cached, and the caches take at
+ * most 10 bytes * CACHE_SLOTS (10 MiB) per thread whatever the scale.  With
+ * 32-bit counters there are no caches, every endpoint is an atomic increment
+ * of the shared array, so the memory is only 4 bytes per vertex.
+ *
+ * summary() reports the degree histogram (powers of two), the largest hubs,
+ * isolated vertices and, for a rank count P, the directed edges each rank
+ * gets under the cyclic VERTEX_OWNER mapping of src/ with the memory
+ * convert_graph_to_oned_csr allocates for them. */
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+
+#include "fmt/format.h"
+#include "graph_generator.h"
+
+class degree_stats {
+public:
+    static constexpr int NHUBS = 10;
+    static constexpr int64_t CACHE_SLOTS = int64_t(1) << 20;
+
+    /* counter_bits is 16 or 32. */
+    degree_stats(int log_numverts, int counter_bits)
+        : log_numverts(log_numverts), nverts(int64_t(1) << log_numverts), degrees(nverts, 0) {
+        if(counter_bits == 16) {
+            int64_t slots = std::min(nverts, CACHE_SLOTS);
+            local.resize(omp_get_max_threads());
+            for(auto& c : local) {
+                /* Slot s starts as vertex s with count 0. */
+                c.tags.resize(slots);
+                for(int64_t s = 0; s < slots; s++) c.tags[s] = s;
+                c.counts.assign(slots, 0);
+            }
+        }
+    }
+
+    void add_block(const packed_edge* edges, size_t nedges) {
+        uint64_t loops = 0;
+        #pragma omp parallel reduction(+:loops)
+        {
+            counter_cache* counters = local.empty() ? nullptr : &local[omp_get_thread_num()];
+            #pragma omp for schedule(static)
+            for(size_t i = 0; i < nedges; i++) {
+                int64_t v0 = get_v0_from_edge(edges + i);
+                int64_t v1 = get_v1_from_edge(edges + i);
+                if(v0 == v1) {
+                    loops++;
+                    continue;
+                }
+                if(counters) {
+                    count(counters, v0);
+                    count(counters, v1);
+                } else {
+                    __atomic_fetch_add(&degrees[v0], 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&degrees[v1], 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+        self_loops += loops;
+        input_edges += nedges;
+    }
+
+    /* Flush the private counters into the shared degrees, which can then be
+     * combined across processes. */
+    std::vector<uint32_t>& finish() {
+        if(!local.empty()) {
+            int64_t slots = static_cast<int64_t>(local[0].tags.size());
+            #pragma omp parallel for schedule(static)
+            for(int64_t s = 0; s < slots; s++) {
+                for(auto& c : local) {
+                    if(c.counts[s]) __atomic_fetch_add(&degrees[c.tags[s]], c.counts[s], __ATOMIC_RELAXED);
+                }
+            }
+            local.clear();
+            local.shrink_to_fit();
+        }
+        return degrees;
+    }
+
+    /* JSON summary; edges and loops are the totals over all processes. */
+    std::string summary(int64_t edgefactor, uint64_t edges, uint64_t loops, int nranks) const {
+        const int NBINS = 34;
+        int nthreads = omp_get_max_threads();
+        std::vector<uint64_t> bins(static_cast<size_t>(nthreads) * NBINS, 0);
+        std::vector<uint64_t> rank_edges(static_cast<size_t>(nthreads) * nranks, 0);
+        std::vector<std::vector<std::pair<uint32_t, int64_t>>> hubs(nthreads);
+
+        #pragma omp parallel
+        {
+            int tid = omp_get_thread_num();
+            uint64_t* b = &bins[static_cast<size_t>(tid) * NBINS];
+            uint64_t* re = &rank_edges[static_cast<size_t>(tid) * nranks];
+            auto& top = hubs[tid];
+            #pragma omp for schedule(static)
+            for(int64_t v = 0; v < nverts; v++) {
+                uint32_t d = degrees[v];
+                b[d == 0 ? 0 : 1 + (31 - __builtin_clz(d))]++;
+                re[v % nranks] += d;
+                if(top.size() < NHUBS || d > top.front().first) {
+                    /* Min-heap of the largest degrees seen by this thread */
+                    auto cmp = std::greater<std::pair<uint32_t, int64_t>>();
+                    top.push_back({d, v});
+                    std::push_heap(top.begin(), top.end(), cmp);
+                    if(top.size() > NHUBS) {
+                        std::pop_heap(top.begin(), top.end(), cmp);
+                        top.pop_back();
+                    }
+                }
+            }
+        }
+
+        for(int t = 1; t < nthreads; t++) {
+            for(int i = 0; i < NBINS; i++) bins[i] += bins[static_cast<size_t>(t) * NBINS + i];
+            for(int r = 0; r < nranks; r++) rank_edges[r] += rank_edges[static_cast<size_t>(t) * nranks + r];
+            hubs[0].insert(hubs[0].end(), hubs[t].begin(), hubs[t].end());
+        }
+        std::vector<std::pair<uint32_t, int64_t>>& top = hubs[0];
+        std::sort(top.begin(), top.end(), [](const auto& a, const auto& b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+        if(top.size() > NHUBS) top.resize(NHUBS);
+
+        std::string s = "{\n";
+        s += fmt::format("  \"scale\": {},\n  \"edgefactor\": {},\n  \"vertices\": {},\n  \"edges\": {},\n",
+                         log_numverts, edgefactor, nverts, edges);
+        s += fmt::format("  \"self_loops\": {},\n  \"isolated_vertices\": {},\n  \"max_degree\": {},\n  \"mean_degree\": {:.3f},\n",
+                         loops, bins[0], top.empty() ? 0 : top[0].first, 2.0 * (edges - loops) / nverts);
+
+        s += "  \"degree_histogram\": [";
+        int last = NBINS - 1;
+        while(last > 0 && bins[last] == 0) last--;
+        for(int i = 0; i <= last; i++) {
+            uint64_t lo = i == 0 ? 0 : uint64_t(1) << (i - 1);
+            uint64_t hi = i == 0 ? 0 : (uint64_t(1) << i) - 1;
+            s += fmt::format("{}\n    {{\"min\": {}, \"max\": {}, \"vertices\": {}}}", i ? "," : "", lo, hi, bins[i]);
+        }
+        s += "\n  ],\n";
+
+        s += "  \"hubs\": [";
+        for(size_t i = 0; i < top.size(); i++) {
+            s += fmt::format("{}\n    {{\"vertex\": {}, \"degree\": {}}}", i ? "," : "", top[i].second, top[i].first);
+        }
+        s += "\n  ],\n";
+
+        /* convert_graph_to_oned_csr: unsigned int rowstarts per local vertex
+         * plus one, BYTES_PER_VERTEX (6) bytes per column entry rounded up
+         * to 4 KiB, and a float weight per entry with SSSP. */
+        uint64_t min_edges = UINT64_MAX, max_edges = 0, sum_edges = 0, max_bytes = 0, max_sssp_bytes = 0;
+        bool overflow = false;
+        for(int r = 0; r < nranks; r++) {
+            uint64_t e = rank_edges[r];
+            uint64_t nlocalverts = static_cast<uint64_t>((nverts + nranks - 1 - r) / nranks);
+            uint64_t bytes = 4 * (nlocalverts + 1) + (6 * e + 4095) / 4096 * 4096;
+            min_edges = std::min(min_edges, e);
+            max_edges = std::max(max_edges, e);
+            sum_edges += e;
+            max_bytes = std::max(max_bytes, bytes);
+            max_sssp_bytes = std::max(max_sssp_bytes, bytes + 4 * e);
+            overflow = overflow || e > UINT32_MAX;
+        }
+        double mean_edges = static_cast<double>(sum_edges) / nranks;
+        s += fmt::format("  \"ranks\": {},\n", nranks);
+        s += fmt::format("  \"rank_edges\": {{\"min\": {}, \"max\": {}, \"mean\": {:.1f}, \"imbalance_pct\": {:.2f}, \"max_over_mean\": {:.4f}}},\n",
+                         min_edges, max_edges, mean_edges,
+                         mean_edges > 0 ? 100.0 * (max_edges - min_edges) / mean_edges : 0.0,
+                         mean_edges > 0 ? max_edges / mean_edges : 0.0);
+        s += fmt::format("  \"csr_bytes_per_rank\": {{\"bfs\": {}, \"sssp\": {}}},\n", max_bytes, max_sssp_bytes);
+        s += fmt::format("  \"rowstarts_overflow\": {}\n", overflow ? "true" : "false");
+        s += "}\n";
+        return s;
+    }
+
+    uint64_t edges() const { return input_edges; }
+    uint64_t loops() const { return self_loops; }
+
+private:
+    struct counter_cache {
+        std::vector<int64_t> tags;
+        std::vector<uint16_t> counts;
+    };
+
+    void count(counter_cache* c, int64_t v) {
+        size_t s = static_cast<size_t>(v) & (c->tags.size() - 1);
+        if(c->tags[s] != v) {
+            if(c->counts[s]) __atomic_fetch_add(&degrees[c->tags[s]], c->counts[s], __ATOMIC_RELAXED);
+            c->tags[s] = v;
+            c->counts[s] = 0;
+        }
+        if(++c->counts[s] == UINT16_MAX) {
+            __atomic_fetch_add(&degrees[v], UINT16_MAX, __ATOMIC_RELAXED);
+            c->counts[s] = 0;
+        }
+    }
+
+    int log_numverts;
+    int64_t nverts;
+    uint64_t input_edges = 0;
+    uint64_t self_loops = 0;
+    std::vector<uint32_t> degrees;
+    std::vector<counter_cache> local;
+};
+
+#endif /* DEGREE_STATS_HPP */
@@ -0,0 +1,368 @@
+#ifndef DIRECT_WRITER_HPP
+#define DIRECT_WRITER_HPP
+
+/* Writes files with O_DIRECT from a few aligned buffers instead of through a
+ * MAP_SHARED mapping, so large blocks neither fill the page cache nor stall
+ * in msync/munmap.  Each buffer is filled in parallel and submitted as one
+ * asynchronous write while the next one is filled.  Writes go through
+ * io_uring when the kernel allows it (raw system calls, no liburing needed),
+ * otherwise through a pool of pwrite threads.  Filesystems without O_DIRECT
+ * (tmpfs) are written through the page cache with the same code.
+ *
+ * O_DIRECT needs aligned offsets and lengths: a file whose end is not
+ * aligned (single-file appends) has its last partial page read back and
+ * rewritten, and the padding after the last item is cut off by ftruncate. */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Write len bytes at offset off, retrying on short writes. */
+inline void pwrite_all(int fd, const char* buf, size_t len, off_t off) {
+    while(len > 0) {
+        ssize_t n = pwrite(fd, buf, len, off);
+        if(n == -1) {
+            if(errno == EINTR) continue;
+            std::cout << "pwrite failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+        buf += n;
+        len -= n;
+        off += n;
+    }
+}
+
+/* Asynchronous writes with completion by tag. */
+class direct_engine {
+public:
+    virtual ~direct_engine() {}
+    virtual void submit(int fd, const char* buf, size_t len, off_t off, int tag) = 0;
+    /* Wait for any submitted write and return its tag. */
+    virtual int wait() = 0;
+    virtual const char* name() const = 0;
+};
+
+class direct_uring : public direct_engine {
+public:
+    /* Returns nullptr if io_uring is not available. */
+    static direct_uring* create(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if(fd < 0) return nullptr;
+        direct_uring* r = new direct_uring(fd, p);
+        if(!r->ok) {
+            delete r;
+            return nullptr;
+        }
+        return r;
+    }
+
+    ~direct_uring() override {
+        if(sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+        if(cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        if(sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        close(ring_fd);
+    }
+
+    void submit(int fd, const char* buf, size_t len, off_t off, int tag) override {
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &static_cast<io_uring_sqe*>(sqes)[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->off = static_cast<uint64_t>(off);
+        sqe->user_data = static_cast<uint64_t>(tag);
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        pending.push_back({fd, buf, len, off, tag});
+        enter(1, 0, 0);
+    }
+
+    int wait() override {
+        unsigned head = *cq_head;
+        while(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+        io_uring_cqe cqe = static_cast<io_uring_cqe*>(cqes)[head & *cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+        int tag = static_cast<int>(cqe.user_data);
+        auto it = std::find_if(pending.begin(), pending.end(), [&](const request& r) { return r.tag == tag; });
+        request req = *it;
+        pending.erase(it);
+        if(cqe.res < 0 || static_cast<size_t>(cqe.res) < req.len) {
+            /* Kernels before 5.6 have no IORING_OP_WRITE (-EINVAL), and a
+             * short write is possible in principle: finish it synchronously. */
+            size_t done = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+            if(cqe.res < 0 && cqe.res != -EINVAL && cqe.res != -EOPNOTSUPP && cqe.res != -EAGAIN) {
+                errno = -cqe.res;
+                std::cout << "io_uring write failed." << std::endl;
+                std::cout << std::strerror(errno) << std::endl;
+                exit(errno);
+            }
+            pwrite_all(req.fd, req.buf + done, req.len - done, req.off + done);
+        }
+        return tag;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    struct request {
+        int fd;
+        const char* buf;
+        size_t len;
+        off_t off;
+        int tag;
+    };
+
+    direct_uring(int fd, const io_uring_params& p) : ring_fd(fd) {
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        ok = sq_ring != MAP_FAILED && cq_ring != MAP_FAILED && sqes != MAP_FAILED;
+        if(!ok) return;
+        char* sq = static_cast<char*>(sq_ring);
+        char* cq = static_cast<char*>(cq_ring);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = cq + p.cq_off.cqes;
+    }
+
+    void enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        while(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0) < 0) {
+            if(errno == EINTR) continue;
+            std::cout << "io_uring_enter failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+    }
+
+    int ring_fd;
+    bool ok = false;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    void* sq_ring = MAP_FAILED;
+    void* cq_ring = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    void* cqes = nullptr;
+    unsigned *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+    std::vector<request> pending;
+};
+
+class direct_pwrite : public direct_engine {
+public:
+    explicit direct_pwrite(int nthreads) {
+        for(int i = 0; i < nthreads; i++) {
+            threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~direct_pwrite() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_all();
+        for(auto& t : threads) t.join();
+    }
+
+    void submit(int fd, const char* buf, size_t len, off_t off, int tag) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({fd, buf, len, off, tag});
+        }
+        queued.notify_one();
+    }
+
+    int wait() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait(lock, [this]() { return !done.empty(); });
+        int tag = done.front();
+        done.pop_front();
+        return tag;
+    }
+
+    const char* name() const override { return "pwrite threads"; }
+
+private:
+    struct request {
+        int fd;
+        const char* buf;
+        size_t len;
+        off_t off;
+        int tag;
+    };
+
+    void run() {
+        while(true) {
+            request r;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if(requests.empty()) return;
+                r = requests.front();
+                requests.pop_front();
+            }
+            pwrite_all(r.fd, r.buf, r.len, r.off);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(r.tag);
+            }
+            completed.notify_one();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable queued, completed;
+    std::deque<request> requests;
+    std::deque<int> done;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+};
+
+class direct_writer {
+public:
+    static constexpr size_t ALIGN = 4096;
+    static constexpr size_t BUF_BYTES = size_t(8) << 20;
+    static constexpr int NBUFS = 8;
+
+    /* use_uring: try io_uring first, else only pwrite threads. */
+    explicit direct_writer(bool use_uring) {
+        if(use_uring) engine.reset(direct_uring::create(NBUFS));
+        if(!engine) engine.reset(new direct_pwrite(NBUFS / 2));
+        for(int i = 0; i < NBUFS; i++) {
+            void* p;
+            if(posix_memalign(&p, ALIGN, BUF_BYTES) != 0) {
+                std::cout << "posix_memalign failed." << std::endl;
+                exit(ENOMEM);
+            }
+            buffers.push_back(static_cast<char*>(p));
+        }
+    }
+
+    ~direct_writer() {
+        for(char* p : buffers) free(p);
+    }
+
+    /* Write nitems items of item_size bytes (a divisor of ALIGN), appending
+     * to the file or replacing it.  fill(first, count, out) stores items
+     * [first, first + count) at out and may use OpenMP. */
+    void write(const std::filesystem::path& path, size_t item_size, size_t nitems, bool append,
+               const std::function<void(size_t, size_t, char*)>& fill) {
+        double t = now();
+        bool direct = true;
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0664);
+        if(fd == -1 && errno == EINVAL) {
+            direct = false;
+            fd = open(path.c_str(), O_RDWR | O_CREAT, 0664);
+        }
+        if(fd == -1) {
+            std::cout << "open failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+        if(!direct) buffered_files++;
+
+        off_t end = append ? lseek(fd, 0, SEEK_END) : 0;
+        off_t pos = end & ~static_cast<off_t>(ALIGN - 1);
+        size_t head = static_cast<size_t>(end - pos);   /* Bytes of the last partial page to keep */
+        size_t item = 0;
+        int nfree = NBUFS;
+        std::vector<int> free_list;
+        for(int i = 0; i < NBUFS; i++) free_list.push_back(i);
+
+        while(item < nitems || head > 0) {
+            if(nfree == 0) {
+                free_list.push_back(engine->wait());
+                nfree++;
+            }
+            int b = free_list.back();
+            free_list.pop_back();
+            nfree--;
+            char* buf = buffers[b];
+            if(head > 0) {
+                ssize_t n = pread(fd, buf, ALIGN, pos);
+                if(n < static_cast<ssize_t>(head)) {
+                    std::cout << "pread failed." << std::endl;
+                    std::cout << std::strerror(errno) << std::endl;
+                    exit(errno ? errno : EIO);
+                }
+            }
+            size_t count = std::min((BUF_BYTES - head) / item_size, nitems - item);
+            fill(item, count, buf + head);
+            size_t len = head + count * item_size;
+            size_t padded = (len + ALIGN - 1) & ~(ALIGN - 1);
+            memset(buf + len, 0, padded - len);
+            engine->submit(fd, buf, padded, pos, b);
+            pos += padded;
+            item += count;
+            head = 0;
+        }
+        while(nfree < NBUFS) {
+            engine->wait();
+            nfree++;
+        }
+        if(ftruncate(fd, end + static_cast<off_t>(nitems * item_size)) != 0) {
+            std::cout << "ftruncate failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+        close(fd);
+        bytes += nitems * item_size;
+        seconds += now() - t;
+    }
+
+    /* "io_uring" or "pwrite threads", and whether some files had no O_DIRECT. */
+    std::string describe() const {
+        std::string s = engine->name();
+        if(buffered_files) s += ", without O_DIRECT";
+        return s;
+    }
+
+    uint64_t bytes = 0;
+    double seconds = 0;
+
+private:
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::unique_ptr<direct_engine> engine;
+    std::vector<char*> buffers;
+    int64_t buffered_files = 0;
+};
+
+#endif /* DIRECT_WRITER_HPP */
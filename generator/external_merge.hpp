@@ -0,0 +1,208 @@
+#ifndef EXTERNAL_MERGE_HPP
+#define EXTERNAL_MERGE_HPP
+
+/* External merge shared by the writers that need a globally sorted edge
+ * stream (csr_writer, dedup_writer): each sorted block is spilled as a run
+ * and the runs are k-way merged with a small read buffer per run.
+ *
+ * Runs live in their own directory created with mkdtemp next to the output
+ * (".graph500-runs-XXXXXX", files "run-<index>"), so their names never
+ * depend on the output pattern; the directory is removed once merged. */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+struct csr_entry {
+    int64_t src;
+    int64_t dst;
+
+    bool operator<(const csr_entry& o) const {
+        return src < o.src || (src == o.src && dst < o.dst);
+    }
+};
+
+/* csr_entry with the SSSP weight of its edge.  Duplicate edges are ordered by
+ * weight, so the merged order does not depend on how edges were split into
+ * runs. */
+struct weighted_csr_entry {
+    int64_t src;
+    int64_t dst;
+    float weight;
+
+    bool operator<(const weighted_csr_entry& o) const {
+        return src < o.src || (src == o.src && (dst < o.dst || (dst == o.dst && weight < o.weight)));
+    }
+};
+
+/* Minimal buffered stdio wrapper that exits on errors like the writers in
+ * generator_omp.cpp. */
+class csr_file {
+public:
+    csr_file(const std::filesystem::path& path, const char* mode) {
+        file = fopen(path.c_str(), mode);
+        if(file == nullptr) {
+            std::cout << "open failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+        buf.reserve(BUF_BYTES);
+    }
+    csr_file(const csr_file&) = delete;
+    csr_file& operator=(const csr_file&) = delete;
+
+    ~csr_file() {
+        flush();
+        fclose(file);
+    }
+
+    template<typename T>
+    void put(T v) {
+        const char* p = reinterpret_cast<const char*>(&v);
+        buf.insert(buf.end(), p, p + sizeof(T));
+        if(buf.size() >= BUF_BYTES) flush();
+    }
+
+    void write(const void* data, size_t nbytes) {
+        flush();
+        if(nbytes > 0 && fwrite(data, 1, nbytes, file) != nbytes) fail();
+    }
+
+    /* Read up to n items into out; returns the number read. */
+    template<typename T>
+    size_t read(T* out, size_t n) {
+        return fread(out, sizeof(T), n, file);
+    }
+
+private:
+    static constexpr size_t BUF_BYTES = 1 << 22;
+
+    void flush() {
+        if(!buf.empty() && fwrite(buf.data(), 1, buf.size(), file) != buf.size()) fail();
+        buf.clear();
+    }
+
+    [[noreturn]] void fail() {
+        std::cout << "write failed." << std::endl;
+        std::cout << std::strerror(errno) << std::endl;
+        exit(errno);
+    }
+
+    FILE* file;
+    std::vector<char> buf;
+};
+
+template<typename Entry>
+class sorted_runs {
+public:
+    /* Runs are kept in a new directory beside the file output. */
+    explicit sorted_runs(const std::filesystem::path& output) : output(output) {}
+    sorted_runs(const sorted_runs&) = delete;
+    sorted_runs& operator=(const sorted_runs&) = delete;
+
+    ~sorted_runs() {
+        if(!dir.empty()) {
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+        }
+    }
+
+    int64_t size() const { return static_cast<int64_t>(run_sizes.size()); }
+
+    /* Write entries, already sorted, as the next run. */
+    void spill(const std::vector<Entry>& entries) {
+        if(dir.empty()) make_dir();
+        std::filesystem::path run = run_path(size());
+        if(std::filesystem::exists(run)) {
+            std::cout << "run file " << run << " already exists." << std::endl;
+            exit(1);
+        }
+        csr_file(run, "wb").write(entries.data(), entries.size() * sizeof(Entry));
+        run_sizes.push_back(entries.size());
+    }
+
+    /* Pass every spilled entry to emit in sorted order, then delete the
+     * runs. */
+    template<typename Emit>
+    void merge(Emit& emit) {
+        int64_t nruns = size();
+        std::vector<run_reader> runs(nruns);
+        using head = std::pair<Entry, int64_t>;
+        auto cmp = [](const head& a, const head& b) { return b.first < a.first; };
+        std::priority_queue<head, std::vector<head>, decltype(cmp)> heap(cmp);
+
+        for(int64_t r = 0; r < nruns; r++) {
+            runs[r].file.reset(new csr_file(run_path(r), "rb"));
+            runs[r].left = run_sizes[r];
+            if(runs[r].refill()) heap.push({runs[r].buf[0], r});
+        }
+
+        while(!heap.empty()) {
+            auto [e, r] = heap.top();
+            heap.pop();
+            emit(e);
+            run_reader& run = runs[r];
+            run.next++;
+            if(run.next == run.buf.size() && !run.refill()) continue;
+            heap.push({run.buf[run.next], r});
+        }
+
+        runs.clear();
+        std::filesystem::remove_all(dir);
+        dir.clear();
+        run_sizes.clear();
+    }
+
+private:
+    static constexpr size_t RUN_BUF_ENTRIES = 1 << 16;
+
+    struct run_reader {
+        std::unique_ptr<csr_file> file;
+        std::vector<Entry> buf;
+        size_t next = 0;
+        size_t left;
+
+        bool refill() {
+            buf.resize(RUN_BUF_ENTRIES);
+            size_t n = file->read(buf.data(), std::min(buf.size(), left));
+            left -= n;
+            next = 0;
+            buf.resize(n);
+            return n > 0;
+        }
+    };
+
+    void make_dir() {
+        std::filesystem::path parent = output.parent_path();
+        if(parent.empty()) parent = ".";
+        std::filesystem::create_directories(parent);
+        std::string name = (parent / ".graph500-runs-XXXXXX").string();
+        if(mkdtemp(name.data()) == nullptr) {
+            std::cout << "mkdtemp failed." << std::endl;
+            std::cout << std::strerror(errno) << std::endl;
+            exit(errno);
+        }
+        dir = name;
+    }
+
+    std::filesystem::path run_path(int64_t r) const {
+        return dir / ("run-" + std::to_string(r));
+    }
+
+    std::filesystem::path output;
+    std::filesystem::path dir;
+    std::vector<uint64_t> run_sizes;
+};
+
+#endif /* EXTERNAL_MERGE_HPP */
@@ -0,0 +1,215 @@
+/* Throughput and hot-path profile of generate_kronecker_range_weighted.
+ *
+ * For every combination of SCALE, thread count and block size, generates the
+ * whole graph block by block (as generator_omp does, without writing it),
+ * then prints one CSV line with the generation rate, a hash of the edges and
+ * the share of time spent in each stage.  Must be linked with a generator
+ * built with -DGENERATOR_PROFILE ("make bench").
+ *
+ * The hash does not depend on the thread count or block size, so it is
+ * checked against the golden file (lines "scale,edgefactor,seed1,seed2,hash")
+ * and against the other runs of the same SCALE.  Mismatches are reported in
+ * the check column and make the exit status 1. */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cstdlib>
+#include <cstdint>
+
+#include <omp.h>
+
+#include "fmt/format.h"
+#include "cxxopts.hpp"
+
+#include "make_graph.h"
+#include "utils.h"
+
+using namespace std;
+
+static vector<int> parse_list(const string& s) {
+    vector<int> r;
+    stringstream ss(s);
+    string item;
+    while(getline(ss, item, ',')) {
+        if(!item.empty()) r.push_back(stoi(item));
+    }
+    return r;
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+/* Order-aware but chunking-independent hash: sum over edges of a mix of the
+ * edge number and both endpoints. */
+static uint64_t hash_edges(const packed_edge* edges, int64_t start_edge, size_t nedges) {
+    uint64_t h = 0;
+    #pragma omp parallel for reduction(+:h) schedule(static)
+    for(size_t i = 0; i < nedges; i++) {
+        uint64_t v0 = static_cast<uint64_t>(get_v0_from_edge(edges + i));
+        uint64_t v1 = static_cast<uint64_t>(get_v1_from_edge(edges + i));
+        h += mix64(v0 ^ mix64(v1 ^ mix64(static_cast<uint64_t>(start_edge) + i)));
+    }
+    return h;
+}
+
+typedef tuple<int, int64_t, uint64_t, uint64_t> golden_key; /* scale, edgefactor, seed1, seed2 */
+
+static map<golden_key, uint64_t> read_golden(const string& path) {
+    map<golden_key, uint64_t> golden;
+    ifstream in(path);
+    string line;
+    while(getline(in, line)) {
+        if(line.empty() || line[0] == '#') continue;
+        int scale;
+        long long edgefactor;
+        unsigned long long seed1, seed2, hash;
+        if(sscanf(line.c_str(), "%d,%lld,%llu,%llu,%llx", &scale, &edgefactor, &seed1, &seed2, &hash) == 5) {
+            golden[golden_key(scale, edgefactor, seed1, seed2)] = hash;
+        }
+    }
+    return golden;
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("generator_bench", "Sweep generator throughput and print CSV");
+    options.add_options()
+        ("scales", "comma separated SCALEs", cxxopts::value<string>()->default_value("16,18,20"))
+        ("threads", "comma separated thread counts (default: max threads)", cxxopts::value<string>()->default_value(""))
+        ("blocks", "comma separated log2 block sizes", cxxopts::value<string>()->default_value("18,22"))
+        ("m,nedges_per_verts", "#edges per vertex", cxxopts::value<int>()->default_value("16"))
+        ("repeat", "runs per configuration, the fastest is reported", cxxopts::value<int>()->default_value("1"))
+        ("weights", "also generate SSSP weights")
+        ("prng", "random number generator, 'mrg' or 'philox'", cxxopts::value<string>()->default_value("mrg"))
+        ("levels", "recursion levels per random draw with 'mrg'", cxxopts::value<int>()->default_value("1"))
+        ("golden", "golden hash file", cxxopts::value<string>()->default_value(""))
+        ("update-golden", "append missing hashes to the golden file")
+        ("seed1", "user seed 1", cxxopts::value<uint64_t>()->default_value("1"))
+        ("seed2", "user seed 2", cxxopts::value<uint64_t>()->default_value("2"))
+        ("h,help", "print usage")
+        ;
+    auto opt = options.parse(argc, argv);
+    if(opt.count("help")) {
+        cout << options.help() << endl;
+        exit(0);
+    }
+
+    vector<int> scales = parse_list(opt["scales"].as<string>());
+    vector<int> threads = parse_list(opt["threads"].as<string>());
+    if(threads.empty()) threads.push_back(omp_get_max_threads());
+    vector<int> log_blocks = parse_list(opt["blocks"].as<string>());
+    int64_t edgefactor = opt["m"].as<int>();
+    int repeat = max(1, opt["repeat"].as<int>());
+    bool with_weights = opt["weights"].as<bool>();
+    uint64_t seed1 = opt["seed1"].as<uint64_t>();
+    uint64_t seed2 = opt["seed2"].as<uint64_t>();
+    string golden_path = opt["golden"].as<string>();
+    map<golden_key, uint64_t> golden;
+    if(!golden_path.empty()) golden = read_golden(golden_path);
+
+    uint_fast32_t seed[5];
+    make_mrg_seed(seed1, seed2, seed);
+    kronecker_options gen_options = {};
+    string prng = opt["prng"].as<string>();
+    if(prng == "philox") {
+        gen_options.prng = KRONECKER_PRNG_PHILOX;
+    } else if(prng != "mrg") {
+        cout << "wrong prng." << endl;
+        exit(1);
+    }
+    gen_options.levels_per_draw = opt["levels"].as<int>();
+    if(gen_options.levels_per_draw < 1 || gen_options.levels_per_draw > KRONECKER_MAX_LEVELS_PER_DRAW) {
+        cout << "wrong levels." << endl;
+        exit(1);
+    }
+    /* The golden hashes are for the default generator. */
+    bool default_generator = gen_options.prng == KRONECKER_PRNG_MRG && gen_options.levels_per_draw == 1;
+    if(!default_generator) golden.clear();
+    const char* simd = getenv("GENERATOR_SIMD");
+
+    cout << "scale,edgefactor,threads,log_blocksize,weights,prng,levels,simd,edges,seconds,medges_per_s,hash,check,"
+            "skip_pct,bernoulli_pct,scramble_pct,store_pct,batch_pct,weights_pct,ticks_per_edge,rejections_per_draw" << endl;
+
+    bool failed = false;
+    for(int scale : scales) {
+        int64_t nedges = edgefactor << scale;
+        bool have_hash = false;
+        uint64_t scale_hash = 0;
+        for(int nthreads : threads) {
+            omp_set_num_threads(nthreads);
+            for(int log_block : log_blocks) {
+                int64_t block_size = min(int64_t(1) << log_block, nedges);
+                vector<packed_edge> edges(block_size);
+                vector<float> weights(with_weights ? block_size : 0);
+                float* wbuf = with_weights ? weights.data() : nullptr;
+
+                /* Timed runs, without profiling or hashing. */
+                double best = 0;
+                for(int r = 0; r < repeat; r++) {
+                    double elapsed = 0;
+                    for(int64_t start = 0; start < nedges; start += block_size) {
+                        int64_t end = min(start + block_size, nedges);
+                        double t = omp_get_wtime();
+                        generate_kronecker_range_weighted(seed, scale, start, end, edges.data(), wbuf, &gen_options);
+                        elapsed += omp_get_wtime() - t;
+                    }
+                    if(r == 0 || elapsed < best) best = elapsed;
+                }
+
+                /* Profiled run, which also hashes the output; the counters
+                 * only run inside the generator. */
+                uint64_t hash = 0;
+                kronecker_profile total;
+                kronecker_profile_start();
+                for(int64_t start = 0; start < nedges; start += block_size) {
+                    int64_t end = min(start + block_size, nedges);
+                    generate_kronecker_range_weighted(seed, scale, start, end, edges.data(), wbuf, &gen_options);
+                    hash += hash_edges(edges.data(), start, end - start);
+                }
+                kronecker_profile_stop(&total);
+
+                string check = "-";
+                auto it = golden.find(golden_key(scale, edgefactor, seed1, seed2));
+                if(it != golden.end()) {
+                    check = it->second == hash ? "ok" : "MISMATCH";
+                } else if(have_hash) {
+                    check = scale_hash == hash ? "same" : "MISMATCH";
+                }
+                if(check == "MISMATCH") failed = true;
+                if(!have_hash) {
+                    have_hash = true;
+                    scale_hash = hash;
+                }
+
+                double ticks = static_cast<double>(total.skip + total.bernoulli + total.scramble + total.store + total.batch + total.weights);
+                auto pct = [&](uint64_t x) { return ticks > 0 ? 100.0 * x / ticks : 0.0; };
+                cout << fmt::format("{},{},{},{},{},{},{},{},{},{:.6f},{:.3f},{:016x},{},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.6f}",
+                                    scale, edgefactor, nthreads, log_block, with_weights ? 1 : 0, prng, gen_options.levels_per_draw,
+                                    simd ? simd : "auto",
+                                    nedges, best, 1e-6 * nedges / best, hash, check,
+                                    pct(total.skip), pct(total.bernoulli), pct(total.scramble), pct(total.store),
+                                    pct(total.batch), pct(total.weights),
+                                    total.edges ? ticks / total.edges : 0.0,
+                                    total.draws ? static_cast<double>(total.rejections) / total.draws : 0.0) << endl;
+            }
+        }
+
+        golden_key key(scale, edgefactor, seed1, seed2);
+        if(opt["update-golden"].as<bool>() && default_generator && !golden_path.empty() && have_hash && !golden.count(key)) {
+            ofstream out(golden_path, ios::app);
+            out << fmt::format("{},{},{},{},{:016x}", scale, edgefactor, seed1, seed2, scale_hash) << endl;
+            golden[key] = scale_hash;
+        }
+    }
+    return failed ? 1 : 0;
+}
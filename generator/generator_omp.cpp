@@ -10,21 +10,37 @@
 #include <iostream>
 #include <filesystem>
 #include <string>
+#include <vector>
 #include <cmath>
 #include <cstdlib>
 #include <cstdint>
 #include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <array>
+#include <algorithm>
 
 #include <unistd.h>
 #include <omp.h>
+#ifdef GRAPH_GENERATOR_MPI
+#include <mpi.h>
+#endif
 
 #include "fcntl.h"
 #include "sys/mman.h"
 #include "fmt/format.h"
+#include "fmt/compile.h"
 #include "cxxopts.hpp"
 
 #include "make_graph.h"
 #include "utils.h"
+#include "csr_writer.hpp"
+#include "dedup_writer.hpp"
+#include "degree_stats.hpp"
+#include "direct_writer.hpp"
+#include "compressed_edges.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -37,6 +53,21 @@ void write_to_stdout(packed_edge* result, size_t m) {
     }
 }
 
+/* Map [off, off + len) of fd for writing.  Appended blocks start anywhere
+ * in the file, but mmap needs a page-aligned offset, so the mapping starts
+ * lead bytes earlier, at the page holding off; unmap base with len + lead. */
+static char* map_for_write(int fd, size_t off, size_t len, void*& base, size_t& lead) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    lead = off & (page_size - 1);
+    base = mmap(NULL, len + lead, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off - lead);
+    if(base == MAP_FAILED) {
+        cout << "mmap failed." << endl;
+        cout << std::strerror(errno) << endl;
+        exit(errno);
+    }
+    return static_cast<char*>(base) + lead;
+}
+
 template<typename VertexType>
 void write_to_file_binary(fs::path path, packed_edge* result, size_t nedges, bool append) {
     int fd = open(path.c_str(), O_RDWR | O_CREAT, 0664);
@@ -54,13 +85,14 @@ void write_to_file_binary(fs::path path, packed_edge* result, size_t nedges, boo
         off = fs::file_size(path);
     }
     fs::resize_file(path, off + fsize);
-
-    VertexType *file = static_cast<VertexType*>(mmap(NULL, fsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off));
-    if(file == MAP_FAILED) {
-        cout << "mmap failed." << endl;
-        cout << std::strerror(errno) << endl;
-        exit(errno);
+    if(fsize == 0) {
+        close(fd);
+        return;
     }
+
+    void* base;
+    size_t lead;
+    VertexType *file = reinterpret_cast<VertexType*>(map_for_write(fd, off, fsize, base, lead));
     // parallel write to file.
     const size_t LOGN_BLOCK_SZ = 22;
     const size_t BLOCK_SZ = 1 << LOGN_BLOCK_SZ;
@@ -70,26 +102,303 @@ void write_to_file_binary(fs::path path, packed_edge* result, size_t nedges, boo
         *(file + 2*i) = static_cast<VertexType>(get_v0_from_edge(result + i));
         *(file + 2*i + 1) = static_cast<VertexType>(get_v1_from_edge(result + i));
     }
-    munmap(file, fsize);
+    munmap(base, fsize + lead);
     close(fd);
 }
 
-void write_to_file_text(fs::path path, packed_edge* result, size_t nedges, bool append) {
-    FILE *file;
+/* Write the SSSP weights of a block, in the same order as its edges and with
+ * the same parallel mmap scheme as write_to_file_binary. */
+template<typename WeightType>
+void write_to_file_weights(fs::path path, const float* weights, size_t nedges, bool append) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0664);
+    if(fd == -1) {
+        cout << "open failed." << endl;
+        cout << std::strerror(errno) << endl;
+        exit(errno);
+    }
+
+    size_t fsize = sizeof(WeightType) * nedges;
+    size_t off = 0;
     if(append) {
-        file = fopen(path.c_str(), "a");
-    } else {
-        file = fopen(path.c_str(), "w");
+        off = fs::file_size(path);
+    }
+    fs::resize_file(path, off + fsize);
+    if(fsize == 0) {
+        close(fd);
+        return;
     }
-    for (size_t i = 0; i < nedges; i++) {
-        int64_t v[2];
-        v[0] = get_v0_from_edge(result + i);
-        v[1] = get_v1_from_edge(result + i);
-        fputs(fmt::format("{} {}\n", v[0], v[1]).c_str(), file);
+
+    void* base;
+    size_t lead;
+    WeightType *file = reinterpret_cast<WeightType*>(map_for_write(fd, off, fsize, base, lead));
+    const size_t LOGN_BLOCK_SZ = 22;
+    const size_t BLOCK_SZ = 1 << LOGN_BLOCK_SZ;
+
+    #pragma omp parallel for schedule(static, BLOCK_SZ)
+    for(size_t i=0; i<nedges; i++) {
+        file[i] = quantize_weight<WeightType>(weights[i]);
     }
-    fclose(file);
+    munmap(base, fsize + lead);
+    close(fd);
+}
+
+/* Same files as write_to_file_binary and write_to_file_weights, written with
+ * O_DIRECT from aligned buffers by a direct_writer. */
+template<typename VertexType>
+void write_to_file_binary_direct(direct_writer& writer, fs::path path, packed_edge* result, size_t nedges, bool append) {
+    writer.write(path, 2 * sizeof(VertexType), nedges, append, [&](size_t first, size_t count, char* out) {
+        VertexType* file = reinterpret_cast<VertexType*>(out);
+        #pragma omp parallel for schedule(static)
+        for(size_t i=0; i<count; i++) {
+            file[2*i] = static_cast<VertexType>(get_v0_from_edge(result + first + i));
+            file[2*i + 1] = static_cast<VertexType>(get_v1_from_edge(result + first + i));
+        }
+    });
+}
+
+template<typename WeightType>
+void write_to_file_weights_direct(direct_writer& writer, fs::path path, const float* weights, size_t nedges, bool append) {
+    writer.write(path, sizeof(WeightType), nedges, append, [&](size_t first, size_t count, char* out) {
+        WeightType* file = reinterpret_cast<WeightType*>(out);
+        #pragma omp parallel for schedule(static)
+        for(size_t i=0; i<count; i++) {
+            file[i] = quantize_weight<WeightType>(weights[first + i]);
+        }
+    });
+}
+
+/* Owner of a vertex when distributed cyclically over nshards ranks, as
+ * VERTEX_OWNER in src/common.h. */
+static inline int vertex_owner(int64_t v, int nshards) {
+    return static_cast<int>(v % nshards);
+}
+
+/* Split nedges edges into nshards owner shards, keeping generation order in
+ * each shard.  An edge is placed in the shard of each endpoint's owner (once
+ * if both have the same owner), so a rank loading its shard holds every edge
+ * that convert_graph_to_oned_csr would send to it.  Shard r is
+ * out[shard_start[r], shard_start[r + 1]). */
+void partition_by_owner(const packed_edge* edges, size_t nedges, int nshards, packed_edge* out, vector<size_t>& shard_start) {
+    vector<size_t> offsets(static_cast<size_t>(omp_get_max_threads()) * nshards, 0);
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        size_t* off = &offsets[static_cast<size_t>(tid) * nshards];
+
+        #pragma omp for schedule(static)
+        for(size_t i=0; i<nedges; i++) {
+            int r0 = vertex_owner(get_v0_from_edge(edges + i), nshards);
+            int r1 = vertex_owner(get_v1_from_edge(edges + i), nshards);
+            off[r0]++;
+            if(r1 != r0) off[r1]++;
+        }
+
+        /* Turn per-thread counts into write positions: shard-major, then by
+         * thread, so each shard stays in edge order. */
+        #pragma omp single
+        {
+            int nthreads = omp_get_num_threads();
+            size_t pos = 0;
+            for(int r = 0; r < nshards; r++) {
+                shard_start[r] = pos;
+                for(int t = 0; t < nthreads; t++) {
+                    size_t count = offsets[static_cast<size_t>(t) * nshards + r];
+                    offsets[static_cast<size_t>(t) * nshards + r] = pos;
+                    pos += count;
+                }
+            }
+            shard_start[nshards] = pos;
+        }
+
+        #pragma omp for schedule(static)
+        for(size_t i=0; i<nedges; i++) {
+            int r0 = vertex_owner(get_v0_from_edge(edges + i), nshards);
+            int r1 = vertex_owner(get_v1_from_edge(edges + i), nshards);
+            out[off[r0]++] = edges[i];
+            if(r1 != r0) out[off[r1]++] = edges[i];
+        }
+    }
+}
+
+/* Formats each edge as "v0 v1\n" (same bytes as fmt::format("{} {}\n", ...))
+ * into per-thread buffers.  In every round each thread formats one chunk;
+ * the chunk lengths give each thread its file offset, so the chunks are
+ * written in order with pwrite while the buffers are reused for the next
+ * round. */
+void write_to_file_text(fs::path path, packed_edge* result, size_t nedges, bool append) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0664);
+    if(fd == -1) {
+        cout << "open failed." << endl;
+        cout << std::strerror(errno) << endl;
+        exit(errno);
+    }
+    off_t base = append ? lseek(fd, 0, SEEK_END) : 0;
+
+    const size_t CHUNK_EDGES = 1 << 16;
+    const size_t MAX_EDGE_CHARS = 2 * 20 + 2; // two int64, a space and a newline
+    size_t nchunks = (nedges + CHUNK_EDGES - 1) / CHUNK_EDGES;
+    vector<size_t> chunk_len(omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        size_t nthreads = omp_get_num_threads();
+        vector<char> buf(CHUNK_EDGES * MAX_EDGE_CHARS);
+        off_t round_base = base;
+        for(size_t first = 0; first < nchunks; first += nthreads) {
+            size_t c = first + tid;
+            char* p = buf.data();
+            if(c < nchunks) {
+                size_t end = min((c + 1) * CHUNK_EDGES, nedges);
+                for(size_t i = c * CHUNK_EDGES; i < end; i++) {
+                    p = fmt::format_to(p, FMT_COMPILE("{} {}\n"), get_v0_from_edge(result + i), get_v1_from_edge(result + i));
+                }
+            }
+            chunk_len[tid] = p - buf.data();
+            #pragma omp barrier
+            off_t off = round_base;
+            for(int t = 0; t < tid; t++) {
+                off += chunk_len[t];
+            }
+            for(size_t t = 0; t < nthreads; t++) {
+                round_base += chunk_len[t];
+            }
+            pwrite_all(fd, buf.data(), chunk_len[tid], off);
+            #pragma omp barrier
+        }
+    }
+    close(fd);
+}
+
+/* Writes the compressed format described in compressed_edges.h.  Blocks of
+ * CEDGES_BLOCK_EDGES edges are sorted and encoded in parallel, one per thread
+ * per round, and written in order with pwrite as in write_to_file_text.
+ * Appending loads the index of the existing file and rewrites it after the
+ * new blocks. */
+void write_to_file_compressed(fs::path path, packed_edge* result, size_t nedges, bool append) {
+    vector<uint64_t> offsets, first_edges;
+    uint64_t data_end = 0, edge_base = 0;
+    if(append && fs::exists(path)) {
+        cedges_file f;
+        if(cedges_open(path.c_str(), &f) == -1) {
+            cout << "open failed." << endl;
+            cout << std::strerror(errno) << endl;
+            exit(errno);
+        }
+        offsets.assign(f.offsets, f.offsets + f.nblocks);
+        first_edges.assign(f.first_edges, f.first_edges + f.nblocks);
+        data_end = f.offsets[f.nblocks];
+        edge_base = f.nedges;
+        cedges_close(&f);
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0664);
+    if(fd == -1) {
+        cout << "open failed." << endl;
+        cout << std::strerror(errno) << endl;
+        exit(errno);
+    }
+
+    size_t nchunks = (nedges + CEDGES_BLOCK_EDGES - 1) / CEDGES_BLOCK_EDGES;
+    size_t first_chunk = offsets.size();
+    offsets.resize(first_chunk + nchunks);
+    first_edges.resize(first_chunk + nchunks);
+    vector<size_t> chunk_len(omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        size_t nthreads = omp_get_num_threads();
+        vector<array<int64_t, 2>> pairs(CEDGES_BLOCK_EDGES);
+        vector<uint8_t> buf(cedges_max_encoded_size(CEDGES_BLOCK_EDGES));
+        off_t round_base = data_end;
+        for(size_t first = 0; first < nchunks; first += nthreads) {
+            size_t c = first + tid;
+            size_t len = 0;
+            if(c < nchunks) {
+                size_t begin = c * CEDGES_BLOCK_EDGES;
+                size_t n = min(begin + CEDGES_BLOCK_EDGES, nedges) - begin;
+                for(size_t i = 0; i < n; i++) {
+                    pairs[i] = {get_v0_from_edge(result + begin + i), get_v1_from_edge(result + begin + i)};
+                }
+                sort(pairs.begin(), pairs.begin() + n);
+                len = cedges_encode_block(pairs[0].data(), n, buf.data());
+                first_edges[first_chunk + c] = edge_base + begin;
+            }
+            chunk_len[tid] = len;
+            #pragma omp barrier
+            off_t off = round_base;
+            for(int t = 0; t < tid; t++) {
+                off += chunk_len[t];
+            }
+            for(size_t t = 0; t < nthreads; t++) {
+                round_base += chunk_len[t];
+            }
+            if(c < nchunks) {
+                offsets[first_chunk + c] = off;
+                pwrite_all(fd, reinterpret_cast<char*>(buf.data()), len, off);
+            }
+            #pragma omp barrier
+        }
+        #pragma omp master
+        data_end = round_base;
+    }
+
+    cedges_trailer trailer;
+    trailer.nblocks = offsets.size();
+    trailer.nedges = edge_base + nedges;
+    trailer.index_offset = data_end;
+    trailer.magic = CEDGES_MAGIC;
+    offsets.push_back(data_end);
+    first_edges.push_back(trailer.nedges);
+
+    size_t index_bytes = offsets.size() * sizeof(uint64_t);
+    pwrite_all(fd, reinterpret_cast<char*>(offsets.data()), index_bytes, data_end);
+    pwrite_all(fd, reinterpret_cast<char*>(first_edges.data()), index_bytes, data_end + index_bytes);
+    pwrite_all(fd, reinterpret_cast<char*>(&trailer), sizeof(trailer), data_end + 2 * index_bytes);
+    if(ftruncate(fd, data_end + 2 * index_bytes + sizeof(trailer)) == -1) {
+        cout << "ftruncate failed." << endl;
+        cout << std::strerror(errno) << endl;
+        exit(errno);
+    }
+    close(fd);
 }
 
+/* A generated block waiting to be written; index < 0 marks end of stream. */
+struct edge_block {
+    packed_edge* edges;
+    float* weights; /* nullptr unless weights are written */
+    int64_t index;
+    size_t nedges;
+};
+
+/* Blocking FIFO used to pass buffers between the generating and writing
+ * stages of the pipeline. */
+class block_queue {
+public:
+    void push(edge_block b) {
+        {
+            lock_guard<mutex> lock(mtx);
+            q.push_back(b);
+        }
+        cv.notify_one();
+    }
+
+    edge_block pop() {
+        unique_lock<mutex> lock(mtx);
+        cv.wait(lock, [this]{ return !q.empty(); });
+        edge_block b = q.front();
+        q.pop_front();
+        return b;
+    }
+
+private:
+    mutex mtx;
+    condition_variable cv;
+    deque<edge_block> q;
+};
+
 int main(int argc, char* argv[]) {
     cxxopts::Options options("KronGenerator", "Generate Kron Graph with 2^n vertices and m*2^n edges");
     options
@@ -101,14 +410,45 @@ int main(int argc, char* argv[]) {
         ("e,max_edges", "max #edges to generate, for graph with #edges < #vertices", cxxopts::value<int64_t>())
         ("o,path", "output file path, {n} is the wildcards and pass to the fmt::format, replacement rule: \n"
                     "{0}: log_numverts\n{1}: nedges_per_verts\n"
-                    "{2}: data format, 'txt' for text, 'bin' for binary\n"
+                    "{2}: data format, 'txt' for text, 'bin' for binary, 'offsets' and 'neighbors' for CSR, 'cbin' for compressed, "
+                    "'weights' for weights\n"
                     "{3}: file number, necessary when graph is large than filesize",
                     cxxopts::value<string>()->default_value("/data/Kron/Kron{0}-{1}/block-{3:02}.{2}"))
         ("b,log_blocksize", "max number of edges be generated in an iteration, must fit in memory",
                     cxxopts::value<int>()->default_value("30"))
         ("s,single_file", "generate edges to single file, rather than one file per block")
-        ("f,format", "output format (0: stdout, 1:binary, 2:text)", cxxopts::value<int>()->default_value("0"))
+        ("f,format", "output format (0: stdout, 1:binary, 2:text, 3:CSR, 4:compressed binary)", cxxopts::value<int>()->default_value("0"))
         ("S,short", "use 32bit int as vertex ID in binary format")
+        ("P,shards", "write one shard per MPI rank for this rank count, {3} in path is the shard "
+                    "number; edge (u, v) goes to the shards of both owners u % P and v % P",
+                    cxxopts::value<int>()->default_value("0"))
+        ("p,pipeline", "number of block buffers; with 2 (double) or 3 (triple) buffering, "
+                    "the next block is generated while the previous one is written",
+                    cxxopts::value<int>()->default_value("1"))
+        ("w,weights", "also write the SSSP edge weights of binary, text or CSR output, {2} is 'weights' "
+                    "(0: none, 1: float, 2: 16-bit, round(w * 65535))",
+                    cxxopts::value<int>()->default_value("0"))
+        ("prng", "random number generator: 'mrg' (Graph500 specification) or 'philox' (counter-based, "
+                    "faster, but a different graph)", cxxopts::value<string>()->default_value("mrg"))
+        ("L,levels", "recursion levels decided per random draw with 'mrg' (1: Graph500 specification, "
+                    "2-4: faster, a different graph with the same distribution)",
+                    cxxopts::value<int>()->default_value("1"))
+        ("initiator", "Kronecker initiator probabilities a,b,c (d = 1 - a - b - c), b and c may differ",
+                    cxxopts::value<string>()->default_value("0.57,0.19,0.19"))
+        ("noise", "initiator noise level (Seshadhri et al.), at most b and c",
+                    cxxopts::value<double>()->default_value("0"))
+        ("D,dedup", "drop self loops and duplicate undirected edges, writing each edge once as (u, v), u < v, "
+                    "sorted; runs are spilled beside the output and merged when the graph is larger than one block")
+        ("stats", "write degree statistics of the generated edges as JSON to this path ('-' for stdout)",
+                    cxxopts::value<string>()->default_value(""))
+        ("stats-ranks", "rank count for the per-rank edge and CSR memory estimates in the statistics",
+                    cxxopts::value<int>()->default_value("1"))
+        ("stats-width", "degree counters: 16 (a per-thread cache of 2^20 saturating counters, up to 10 MiB per "
+                    "thread, on top of the shared 4 bytes per vertex) or 32 (shared, atomic, 4 bytes per vertex)",
+                    cxxopts::value<int>()->default_value("16"))
+        ("writer", "binary and weights file writer: 'mmap' (shared mapping), 'direct' (O_DIRECT, io_uring, "
+                    "pwrite threads if io_uring is unavailable) or 'pwrite' (O_DIRECT, pwrite threads)",
+                    cxxopts::value<string>()->default_value("mmap"))
         ("v,info", "show debug messages")
         ("seed1", "user seed 1", cxxopts::value<uint64_t>()->default_value("1"))
         ("seed2", "user seed 2", cxxopts::value<uint64_t>()->default_value("2"))
@@ -136,65 +476,368 @@ int main(int argc, char* argv[]) {
     int64_t nblocks = desired_nedges / block_size + (desired_nedges % block_size != 0);
     bool single_file = opt["single_file"].as<bool>();
 
+    int nbuffers = max(1, opt["pipeline"].as<int>());
+    bool info = opt["info"].as<bool>();
+
     uint_fast32_t seed[5];
     make_mrg_seed(seed1, seed2, seed);
 
-    for(int64_t i=0; i < nblocks; i++) {
-        int64_t start_edge = i * block_size;
-        int64_t end_edge = min((i+1)*block_size, desired_nedges);
-        size_t nblock_edges = static_cast<size_t>(end_edge - start_edge);
-        packed_edge* edges = (packed_edge*)xmalloc(block_size * sizeof(packed_edge));
+    kronecker_options gen_options = {};
+    string prng = opt["prng"].as<string>();
+    if(prng == "philox") {
+        gen_options.prng = KRONECKER_PRNG_PHILOX;
+    } else if(prng != "mrg") {
+        cout << "wrong prng." << endl;
+        exit(1);
+    }
+    gen_options.levels_per_draw = opt["levels"].as<int>();
+    if(gen_options.levels_per_draw < 1 || gen_options.levels_per_draw > KRONECKER_MAX_LEVELS_PER_DRAW
+       || (gen_options.levels_per_draw > 1 && gen_options.prng != KRONECKER_PRNG_MRG)) {
+        cout << "wrong levels." << endl;
+        exit(1);
+    }
+    double initiator_a, initiator_b, initiator_c;
+    if(sscanf(opt["initiator"].as<string>().c_str(), "%lf,%lf,%lf", &initiator_a, &initiator_b, &initiator_c) != 3) {
+        cout << "wrong initiator." << endl;
+        exit(1);
+    }
+    gen_options.initiator_a = static_cast<int>(llround(initiator_a * KRONECKER_INITIATOR_DENOMINATOR));
+    gen_options.initiator_b = static_cast<int>(llround(initiator_b * KRONECKER_INITIATOR_DENOMINATOR));
+    gen_options.initiator_c = static_cast<int>(llround(initiator_c * KRONECKER_INITIATOR_DENOMINATOR));
+    gen_options.noise_level = static_cast<int>(llround(opt["noise"].as<double>() * KRONECKER_INITIATOR_DENOMINATOR));
+    if(!kronecker_options_valid(&gen_options)) {
+        cout << "wrong initiator or noise." << endl;
+        exit(1);
+    }
 
-        if(opt["info"].as<bool>()) {
-            cout << fmt::format("Generating block {}, range [{}, {})", i, start_edge, end_edge) << endl;
-        }
+    /* With MPI, block i is generated and written by rank i % nranks, as
+     * main.c deals out FILE_CHUNKSIZE blocks; every block goes to its own
+     * file, so ranks never share one. */
+    int rank = 0, nranks = 1;
+#ifdef GRAPH_GENERATOR_MPI
+    int thread_level;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_level);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+#endif
 
-        /* Start of graph generation timing */
-        double time_taken = omp_get_wtime();
-        generate_kronecker_range(seed, log_numverts, start_edge, end_edge, edges);
-        time_taken = omp_get_wtime() - time_taken;
-        /* End of graph generation timing */
+    int nshards = opt["shards"].as<int>();
+    int format = opt["format"].as<int>();
+    if(nshards > 0 && (format == 0 || format == 3)) {
+        cout << "sharded output needs format 1, 2 or 4." << endl;
+        exit(1);
+    }
+    if(nranks > 1 && (single_file || nshards > 0 || format == 0 || format == 3)) {
+        cout << "with several MPI ranks, only one file per block in format 1, 2 or 4 is supported." << endl;
+        exit(1);
+    }
+    int weight_format = opt["weights"].as<int>();
+    if(weight_format < 0 || weight_format > 2) {
+        cout << "wrong weights format." << endl;
+        exit(1);
+    }
+    if(weight_format && (nshards > 0 || (format != 1 && format != 2 && format != 3))) {
+        cout << "weights need unsharded format 1, 2 or 3." << endl;
+        exit(1);
+    }
+    bool dedup = opt["dedup"].as<bool>();
+    if(dedup && (nshards > 0 || weight_format || format == 3 || nranks > 1)) {
+        cout << "dedup needs a single rank and unsharded format 0, 1, 2 or 4 without weights." << endl;
+        exit(1);
+    }
+    string stats_path = opt["stats"].as<string>();
+    int stats_ranks = opt["stats-ranks"].as<int>();
+    int stats_width = opt["stats-width"].as<int>();
+    if(!stats_path.empty() && (stats_ranks < 1 || (stats_width != 16 && stats_width != 32))) {
+        cout << "wrong stats-ranks or stats-width." << endl;
+        exit(1);
+    }
+    string writer_name = opt["writer"].as<string>();
+    if(writer_name != "mmap" && writer_name != "direct" && writer_name != "pwrite") {
+        cout << "wrong writer." << endl;
+        exit(1);
+    }
+    unique_ptr<direct_writer> direct;
+    if(writer_name != "mmap") {
+        direct.reset(new direct_writer(writer_name == "direct"));
+    }
+    unique_ptr<degree_stats> stats;
+    if(!stats_path.empty()) {
+        stats.reset(new degree_stats(log_numverts, stats_width));
+    }
+    /* Shard edge buffer, only used by the writing stage.  An edge can be
+     * copied to two shards. */
+    vector<packed_edge> shard_edges;
+    vector<size_t> shard_start(nshards + 1);
+    if(nshards > 0) {
+        shard_edges.resize(2 * static_cast<size_t>(min(block_size, desired_nedges)));
+    }
 
-        if(opt["info"].as<bool>()) {
-            cout << fmt::format("{} edges generated in {}s ({} Medges/s)", nblock_edges, time_taken, 1e-6 * nblock_edges / time_taken  ) << endl;
-        }
+    unique_ptr<csr_writer> csr;
+    if(format == 3) {
+        auto csr_path = [&](const char* kind, int64_t fn) -> fs::path {
+            return fmt::format(path_format, log_numverts, nedges_per_verts, kind, fn);
+        };
+        csr.reset(new csr_writer(csr_path, log_numverts, nblocks, opt["short"].as<bool>(), weight_format));
+    }
 
-        time_taken = omp_get_wtime();
-        bool append = single_file && i > 0;
-        int64_t fn = single_file ? 0 : i;
+    unique_ptr<dedup_writer> cleaner;
+    if(dedup) {
+        fs::path first_path = fmt::format(path_format, log_numverts, nedges_per_verts, "run", 0);
+        cleaner.reset(new dedup_writer(first_path, log_numverts, nblocks));
+    }
+
+    auto write_edges = [&](int64_t fn, packed_edge* edges, size_t nedges, bool append) {
         fs::path path;
-        switch (opt["format"].as<int>()) {
+        switch (format) {
         case 0: // stdout
-            write_to_stdout(edges, nblock_edges);
+            write_to_stdout(edges, nedges);
             break;
         case 1: // binary
             path = fmt::format(path_format, log_numverts, nedges_per_verts, "bin", fn);
             fs::create_directories(path.parent_path());
-            if(opt["short"].as<bool>()){
-                write_to_file_binary<uint32_t>(path, edges, nblock_edges, append);
+            if(direct && opt["short"].as<bool>()) {
+                write_to_file_binary_direct<uint32_t>(*direct, path, edges, nedges, append);
+            } else if(direct) {
+                write_to_file_binary_direct<int64_t>(*direct, path, edges, nedges, append);
+            } else if(opt["short"].as<bool>()){
+                write_to_file_binary<uint32_t>(path, edges, nedges, append);
             } else {
-                write_to_file_binary<int64_t>(path, edges, nblock_edges, append);
+                write_to_file_binary<int64_t>(path, edges, nedges, append);
             }
             break;
         case 2: // text
             path = fmt::format(path_format, log_numverts, nedges_per_verts, "txt", fn);
             fs::create_directories(path.parent_path());
-            write_to_file_text(path, edges, nblock_edges, append);
+            write_to_file_text(path, edges, nedges, append);
+            break;
+        case 3: // CSR, blocks go to csr in write_block
+            break;
+        case 4: // compressed binary
+            path = fmt::format(path_format, log_numverts, nedges_per_verts, "cbin", fn);
+            fs::create_directories(path.parent_path());
+            write_to_file_compressed(path, edges, nedges, append);
             break;
         default:
             cout << "wrong format." << endl;
             cout << options.help() << endl;
             break;
         }
+    };
+
+    auto write_block = [&](const edge_block& b) {
+        if(stats) {
+            stats->add_block(b.edges, b.nedges);
+        }
+        if(cleaner) {
+            /* Written by cleaner->finish() after the last block */
+            cleaner->add_block(b.edges, b.nedges);
+        } else if(csr) {
+            /* Written by csr->finish() after the last block, with the weights */
+            csr->add_block(b.edges, b.weights, b.nedges);
+        } else if(nshards > 0) {
+            /* Every block is appended to the file of each shard. */
+            partition_by_owner(b.edges, b.nedges, nshards, shard_edges.data(), shard_start);
+            for(int r = 0; r < nshards; r++) {
+                write_edges(r, shard_edges.data() + shard_start[r], shard_start[r + 1] - shard_start[r], b.index > 0);
+            }
+        } else {
+            bool append = single_file && b.index > 0;
+            int64_t fn = single_file ? 0 : b.index;
+            write_edges(fn, b.edges, b.nedges, append);
+            if(weight_format) {
+                fs::path path = fmt::format(path_format, log_numverts, nedges_per_verts, "weights", fn);
+                if(direct && weight_format == 1) {
+                    write_to_file_weights_direct<float>(*direct, path, b.weights, b.nedges, append);
+                } else if(direct) {
+                    write_to_file_weights_direct<uint16_t>(*direct, path, b.weights, b.nedges, append);
+                } else if(weight_format == 1) {
+                    write_to_file_weights<float>(path, b.weights, b.nedges, append);
+                } else {
+                    write_to_file_weights<uint16_t>(path, b.weights, b.nedges, append);
+                }
+            }
+        }
+    };
+
+    /* Buffers are allocated once and recycled: the generating stage takes a
+     * buffer from free_blocks, fills it and hands it to the writing stage
+     * through full_blocks, which returns it when the block is on disk.  With a
+     * single buffer both stages simply alternate. */
+    block_queue free_blocks, full_blocks;
+    size_t buffer_size = static_cast<size_t>(min(block_size, desired_nedges));
+    vector<packed_edge*> buffers(nbuffers);
+    vector<float*> weight_buffers;
+    for(auto& buf : buffers) {
+        buf = (packed_edge*)xmalloc(buffer_size * sizeof(packed_edge));
+        float* wbuf = weight_format ? (float*)xmalloc(buffer_size * sizeof(float)) : nullptr;
+        weight_buffers.push_back(wbuf);
+        free_blocks.push({buf, wbuf, -1, 0});
+    }
+
+    double gen_time = 0, write_time = 0;
+    double gen_stall = 0, write_stall = 0;
+    auto writer = [&]() {
+        while(true) {
+            double t = omp_get_wtime();
+            edge_block b = full_blocks.pop();
+            write_stall += omp_get_wtime() - t;
+            if(b.index < 0) break;
+
+            /* Start of graph writing timing */
+            double time_taken = omp_get_wtime();
+            write_block(b);
+            time_taken = omp_get_wtime() - time_taken;
+            /* End of graph writing timing */
+            write_time += time_taken;
+
+            if(info) {
+                cout << fmt::format("{} edges written in {}s ({} Medges/s)", b.nedges, time_taken, 1e-6 * b.nedges / time_taken  ) << endl;
+            }
+            free_blocks.push(b);
+        }
+    };
+
+    double total_time = omp_get_wtime();
+    thread writer_thread;
+    if(nbuffers > 1) {
+        writer_thread = thread(writer);
+    }
+
+    int64_t my_nedges = 0;
+    for(int64_t i=rank; i < nblocks; i += nranks) {
+        int64_t start_edge = i * block_size;
+        int64_t end_edge = min((i+1)*block_size, desired_nedges);
+        size_t nblock_edges = static_cast<size_t>(end_edge - start_edge);
+
+        double t = omp_get_wtime();
+        edge_block b = free_blocks.pop();
+        gen_stall += omp_get_wtime() - t;
+        b.index = i;
+        b.nedges = nblock_edges;
+        my_nedges += nblock_edges;
+
+        if(info) {
+            cout << fmt::format("Generating block {}, range [{}, {})", i, start_edge, end_edge) << endl;
+        }
+
+        /* Start of graph generation timing */
+        double time_taken = omp_get_wtime();
+        generate_kronecker_range_weighted(seed, log_numverts, start_edge, end_edge, b.edges, b.weights, &gen_options);
         time_taken = omp_get_wtime() - time_taken;
-        /* End of graph writing timing */
+        /* End of graph generation timing */
+        gen_time += time_taken;
 
-        if(opt["info"].as<bool>()) {
-            cout << fmt::format("{} edges written in {}s ({} Medges/s)", nblock_edges, time_taken, 1e-6 * nblock_edges / time_taken  ) << endl;
+        if(info) {
+            cout << fmt::format("{} edges generated in {}s ({} Medges/s)", nblock_edges, time_taken, 1e-6 * nblock_edges / time_taken  ) << endl;
         }
 
-        xfree(edges, block_size * sizeof(packed_edge));
+        full_blocks.push(b);
+        if(nbuffers == 1) {
+            full_blocks.push({nullptr, nullptr, -1, 0});
+            writer();
+        }
+    }
+
+    if(nbuffers > 1) {
+        full_blocks.push({nullptr, nullptr, -1, 0});
+        writer_thread.join();
+    }
+    if(csr) {
+        double time_taken = omp_get_wtime();
+        uint64_t ncsr_edges = csr->finish();
+        time_taken = omp_get_wtime() - time_taken;
+        write_time += time_taken;
+        if(info) {
+            cout << fmt::format("CSR with {} directed edges written in {}s", ncsr_edges, time_taken) << endl;
+        }
+    }
+    if(cleaner) {
+        double time_taken = omp_get_wtime();
+        int64_t fn = 0;
+        dedup_stats stats = cleaner->finish(buffer_size, [&](packed_edge* edges, size_t nedges) {
+            write_edges(single_file ? 0 : fn, edges, nedges, single_file && fn > 0);
+            fn++;
+        });
+        time_taken = omp_get_wtime() - time_taken;
+        write_time += time_taken;
+        uint64_t removed = stats.self_loops + stats.duplicates;
+        cout << fmt::format("Dedup: removed {} of {} edges ({:.2f}%): {} self loops, {} duplicates; {} edges left",
+                            removed, my_nedges, 100.0 * removed / max<int64_t>(my_nedges, 1),
+                            stats.self_loops, stats.duplicates, stats.edges) << endl;
+        if(info) {
+            cout << fmt::format("Cleaned edges merged and written in {}s", time_taken) << endl;
+        }
+    }
+    if(stats) {
+        uint64_t edge_count = stats->edges(), loop_count = stats->loops();
+#ifdef GRAPH_GENERATOR_MPI
+        /* Rank 0 sums everyone's degrees, in pieces that fit an int count. */
+        vector<uint32_t>& degrees = stats->finish();
+        const size_t piece = size_t(1) << 28;
+        for(size_t off = 0; off < degrees.size(); off += piece) {
+            int n = static_cast<int>(min(piece, degrees.size() - off));
+            MPI_Reduce(rank == 0 ? MPI_IN_PLACE : degrees.data() + off, degrees.data() + off, n,
+                       MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &edge_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &loop_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+#else
+        stats->finish();
+#endif
+        if(rank == 0) {
+            string json = stats->summary(nedges_per_verts, edge_count, loop_count, stats_ranks);
+            if(stats_path == "-") {
+                cout << json;
+            } else {
+                fs::path path(stats_path);
+                if(path.has_parent_path()) fs::create_directories(path.parent_path());
+                FILE* f = fopen(path.c_str(), "w");
+                if(f == nullptr || fwrite(json.data(), 1, json.size(), f) != json.size() || fclose(f) != 0) {
+                    cout << "stats write failed." << endl;
+                    cout << std::strerror(errno) << endl;
+                    exit(errno);
+                }
+            }
+        }
+    }
+    total_time = omp_get_wtime() - total_time;
+
+    if(direct && direct->bytes > 0) {
+        string who = nranks > 1 ? fmt::format("Rank {}: ", rank) : "";
+        cout << fmt::format("{}{} writer ({}): {:.3f} GB in {:.3f}s ({:.3f} GB/s)", who, writer_name, direct->describe(),
+                            1e-9 * direct->bytes, direct->seconds, 1e-9 * direct->bytes / direct->seconds) << endl;
+    }
+
+    if(info) {
+        string who = nranks > 1 ? fmt::format("Rank {}: ", rank) : "";
+        cout << fmt::format("{}Total {} edges in {}s ({} Medges/s), {} buffer(s)",
+                            who, my_nedges, total_time, 1e-6 * my_nedges / total_time, nbuffers) << endl;
+        cout << fmt::format("  generate: {}s busy ({} Medges/s), {}s waiting for a free buffer",
+                            gen_time, 1e-6 * my_nedges / gen_time, gen_stall) << endl;
+        cout << fmt::format("  write:    {}s busy ({} Medges/s), {}s waiting for a generated block",
+                            write_time, 1e-6 * my_nedges / write_time, write_stall) << endl;
+    }
+
+#ifdef GRAPH_GENERATOR_MPI
+    /* The slowest rank sets the time for the whole graph. */
+    double max_time;
+    MPI_Reduce(&total_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if(info && rank == 0 && nranks > 1) {
+        cout << fmt::format("All {} ranks: {} edges in {}s ({} Medges/s)",
+                            nranks, desired_nedges, max_time, 1e-6 * desired_nedges / max_time) << endl;
+    }
+#endif
+
+    for(auto& buf : buffers) {
+        xfree(buf, buffer_size * sizeof(packed_edge));
+    }
+    for(auto& wbuf : weight_buffers) {
+        if(wbuf) xfree(wbuf, buffer_size * sizeof(float));
     }
 
+#ifdef GRAPH_GENERATOR_MPI
+    MPI_Finalize();
+#endif
     return 0;
 }
@@ -9,16 +9,22 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
 #ifndef __STDC_FORMAT_MACROS
 #define __STDC_FORMAT_MACROS
 #endif
 #include <inttypes.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "user_settings.h"
 #include "splittable_mrg.h"
 #include "graph_generator.h"
+#include "graph_generator_simd.h"
+#include "philox.h"
 
 /* Initiator settings: for faster random number generation, the initiator
  * probabilities are defined as fractions (a = INITIATOR_A_NUMERATOR /
@@ -26,7 +32,7 @@
  * INITIATOR_DENOMINATOR, d = 1 - a - b - c. */
 #define INITIATOR_A_NUMERATOR 5700
 #define INITIATOR_BC_NUMERATOR 1900
-#define INITIATOR_DENOMINATOR 10000
+#define INITIATOR_DENOMINATOR KRONECKER_INITIATOR_DENOMINATOR
 
 /* If this macro is defined to a non-zero value, use SPK_NOISE_LEVEL /
  * INITIATOR_DENOMINATOR as the noise parameter to use in introducing noise
@@ -38,28 +44,104 @@
 #define SPK_NOISE_LEVEL 0
 /* #define SPK_NOISE_LEVEL 1000 -- in INITIATOR_DENOMINATOR units */
 
-static int generate_4way_bernoulli(mrg_state* st, int level, int nlevels) {
+/* The settings above are compiled into the default code path; an initiator or
+ * noise level given in kronecker_options at runtime is expanded into per-level
+ * thresholds instead.  The functions that take a const initiator* are always
+ * inlined and called with a literal NULL for the defaults, so that path keeps
+ * its constant thresholds. */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+#define MAX_LEVELS 64
+
+typedef struct initiator {
+  /* val < t[level][0] picks b (top right), then c below t[level][1], a below
+   * t[level][2] and d otherwise; in INITIATOR_DENOMINATOR units. */
+  uint32_t t[MAX_LEVELS][3];
+  int noise; /* Non-zero if the thresholds change between levels */
+} initiator;
+
+#ifdef GENERATOR_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profile_ticks(void) {return __rdtsc();}
+#else
+#include <time.h>
+static inline uint64_t profile_ticks(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/* One cache line (or two) per thread, so the counters are not shared. */
+typedef union profile_slot_t {
+  kronecker_profile p;
+  char pad[128];
+} profile_slot_t;
+
+static profile_slot_t* profile_slots = NULL;
+static int profile_nslots = 0;
+static _Thread_local kronecker_profile* profile_slot = NULL; /* This thread's counters, or NULL */
+
+#define PROFILE_START(t_) uint64_t t_ = profile_slot ? profile_ticks() : 0
+#define PROFILE_END(field_, t_) do {if (profile_slot) profile_slot->field_ += profile_ticks() - (t_);} while (0)
+#define PROFILE_COUNT(field_, n_) do {if (profile_slot) profile_slot->field_ += (n_);} while (0)
+
+void kronecker_profile_start(void) {
+  free(profile_slots);
+#ifdef _OPENMP
+  profile_nslots = omp_get_max_threads();
+#else
+  profile_nslots = 1;
+#endif
+  profile_slots = (profile_slot_t*)calloc(profile_nslots, sizeof(profile_slot_t));
+}
+
+void kronecker_profile_stop(kronecker_profile* total) {
+  int i;
+  memset(total, 0, sizeof(*total));
+  for (i = 0; i < profile_nslots; ++i) {
+    const kronecker_profile* p = &profile_slots[i].p;
+    total->skip += p->skip;
+    total->bernoulli += p->bernoulli;
+    total->scramble += p->scramble;
+    total->store += p->store;
+    total->batch += p->batch;
+    total->weights += p->weights;
+    total->edges += p->edges;
+    total->draws += p->draws;
+    total->rejections += p->rejections;
+  }
+  free(profile_slots);
+  profile_slots = NULL;
+  profile_nslots = 0;
+}
+#else
+#define PROFILE_START(t_) ((void)0)
+#define PROFILE_END(field_, t_) ((void)0)
+#define PROFILE_COUNT(field_, n_) ((void)0)
+#endif
+
+/* Map val, uniform in [0, INITIATOR_DENOMINATOR), to a quadrant of the
+ * initiator at the given level (the compile-time one if init is NULL). */
+static ALWAYS_INLINE int choose_quadrant(uint32_t val, int level, int nlevels, const initiator* init) {
+  if (init) {
+    const uint32_t* t = init->t[level];
+    return val < t[0] ? 1 : val < t[1] ? 2 : val < t[2] ? 0 : 3;
+  }
 #if SPK_NOISE_LEVEL == 0
   /* Avoid warnings */
   (void)level;
   (void)nlevels;
-#endif
-  /* Generate a pseudorandom number in the range [0, INITIATOR_DENOMINATOR)
-   * without modulo bias. */
-  static const uint32_t limit = (UINT32_C(0x7FFFFFFF) % INITIATOR_DENOMINATOR);
-  uint32_t val = mrg_get_uint_orig(st);
-  if (/* Unlikely */ val < limit) {
-    do {
-      val = mrg_get_uint_orig(st);
-    } while (val < limit);
-  }
-#if SPK_NOISE_LEVEL == 0
   int spk_noise_factor = 0;
 #else
   int spk_noise_factor = 2 * SPK_NOISE_LEVEL * level / nlevels - SPK_NOISE_LEVEL;
 #endif
   unsigned int adjusted_bc_numerator = (unsigned int)(INITIATOR_BC_NUMERATOR + spk_noise_factor);
-  val %= INITIATOR_DENOMINATOR;
   if (val < adjusted_bc_numerator) return 1;
   val = (uint32_t)(val - adjusted_bc_numerator);
   if (val < adjusted_bc_numerator) return 2;
@@ -68,15 +150,60 @@ static int generate_4way_bernoulli(mrg_state* st, int level, int nlevels) {
   if (val < INITIATOR_A_NUMERATOR) return 0;
 #else
   if (val < INITIATOR_A_NUMERATOR * (INITIATOR_DENOMINATOR - 2 * INITIATOR_BC_NUMERATOR) / (INITIATOR_DENOMINATOR - 2 * adjusted_bc_numerator)) return 0;
-#endif
-#if SPK_NOISE_LEVEL == 0
-  /* Avoid warnings */
-  (void)level;
-  (void)nlevels;
 #endif
   return 3;
 }
 
+static ALWAYS_INLINE int generate_4way_bernoulli(mrg_state* st, int level, int nlevels, const initiator* init) {
+  /* Generate a pseudorandom number in the range [0, INITIATOR_DENOMINATOR)
+   * without modulo bias. */
+  static const uint32_t limit = (UINT32_C(0x7FFFFFFF) % INITIATOR_DENOMINATOR);
+  uint32_t val = mrg_get_uint_orig(st);
+  PROFILE_COUNT(draws, 1);
+  if (/* Unlikely */ val < limit) {
+    do {
+      PROFILE_COUNT(rejections, 1);
+      val = mrg_get_uint_orig(st);
+    } while (val < limit);
+  }
+  return choose_quadrant(val % INITIATOR_DENOMINATOR, level, nlevels, init);
+}
+
+/* Draw n (at most KRONECKER_MAX_LEVELS_PER_DRAW) values uniform in [0,
+ * INITIATOR_DENOMINATOR) at once: v uniform in [0, INITIATOR_DENOMINATOR^n)
+ * has n independent base-INITIATOR_DENOMINATOR digits, so splitting it into
+ * digits is the same as looking it up in the cumulative table of the n-level
+ * product initiator, without the table.  One MRG value (31 bits) covers two
+ * levels, and two values (62 bits) cover up to four.  The most significant
+ * digit goes to digits[0]. */
+static inline void generate_multilevel_values(mrg_state* st, int n, uint32_t digits[KRONECKER_MAX_LEVELS_PER_DRAW]) {
+  static const uint64_t range = UINT64_C(0x7FFFFFFF); /* Values of mrg_get_uint_orig */
+  static const uint64_t modulus[KRONECKER_MAX_LEVELS_PER_DRAW + 1] = {
+    1, INITIATOR_DENOMINATOR,
+    (uint64_t)INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR,
+    (uint64_t)INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR,
+    (uint64_t)INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR};
+  uint64_t m = modulus[n];
+  int wide = n > 2;
+  /* As in generate_4way_bernoulli, reject values below limit to avoid
+   * modulo bias. */
+  uint64_t limit = wide ? (range * range) % m : range % m;
+  uint64_t val;
+  int i;
+  PROFILE_COUNT(draws, 1);
+  while (1) {
+    val = mrg_get_uint_orig(st);
+    if (wide) val = val * range + mrg_get_uint_orig(st);
+    if (/* Likely */ val >= limit) break;
+    PROFILE_COUNT(rejections, 1);
+  }
+  val %= m;
+  for (i = n - 1; i >= 0; --i) {
+    digits[i] = (uint32_t)(val % INITIATOR_DENOMINATOR);
+    val /= INITIATOR_DENOMINATOR;
+  }
+}
+
 /* Reverse bits in a number; this should be optimized for performance
  * (including using bit- or byte-reverse intrinsics if your platform has them).
  * */
@@ -140,11 +267,12 @@ static inline int64_t scramble(int64_t v0, int lgN, uint64_t val0, uint64_t val1
 }
 
 /* Make a single graph edge using a pre-set MRG state. */
-static
-void make_one_edge(int64_t nverts, int level, int lgN, mrg_state* st, packed_edge* result, uint64_t val0, uint64_t val1) {
+static ALWAYS_INLINE
+void make_one_edge(int64_t nverts, int level, int lgN, mrg_state* st, const initiator* init, packed_edge* result, uint64_t val0, uint64_t val1) {
   int64_t base_src = 0, base_tgt = 0;
+  PROFILE_START(t_bernoulli);
   while (nverts > 1) {
-    int square = generate_4way_bernoulli(st, level, lgN);
+    int square = generate_4way_bernoulli(st, level, lgN, init);
     int src_offset = square / 2;
     int tgt_offset = square % 2;
     assert (base_src <= base_tgt);
@@ -161,9 +289,266 @@ void make_one_edge(int64_t nverts, int level, int lgN, mrg_state* st, packed_edg
     base_src += nverts * src_offset;
     base_tgt += nverts * tgt_offset;
   }
-  write_edge(result,
-             scramble(base_src, lgN, val0, val1),
-             scramble(base_tgt, lgN, val0, val1));
+  PROFILE_END(bernoulli, t_bernoulli);
+  PROFILE_START(t_scramble);
+  int64_t src = scramble(base_src, lgN, val0, val1);
+  int64_t tgt = scramble(base_tgt, lgN, val0, val1);
+  PROFILE_END(scramble, t_scramble);
+  PROFILE_START(t_store);
+  write_edge(result, src, tgt);
+  PROFILE_END(store, t_store);
+}
+
+/* As make_one_edge, but each draw decides levels_per_draw levels (fewer for
+ * the last group), with generate_multilevel_values. */
+static ALWAYS_INLINE
+void make_one_edge_multilevel(int64_t nverts, int lgN, int levels_per_draw, mrg_state* st, const initiator* init, packed_edge* result, uint64_t val0, uint64_t val1) {
+  int64_t base_src = 0, base_tgt = 0;
+  int level = 0;
+  PROFILE_START(t_bernoulli);
+  while (nverts > 1) {
+    uint32_t digits[KRONECKER_MAX_LEVELS_PER_DRAW];
+    int n = lgN - level < levels_per_draw ? lgN - level : levels_per_draw;
+    int i;
+    /* Constant n, so that the divisions become multiplications */
+    switch (n) {
+      case 1: generate_multilevel_values(st, 1, digits); break;
+      case 2: generate_multilevel_values(st, 2, digits); break;
+      case 3: generate_multilevel_values(st, 3, digits); break;
+      default: generate_multilevel_values(st, 4, digits); break;
+    }
+    for (i = 0; i < n; ++i) {
+      int square = choose_quadrant(digits[i], level, lgN, init);
+      int src_offset = square / 2;
+      int tgt_offset = square % 2;
+      /* Clip-and-flip for undirected graph, without branches since the
+       * quadrants are unpredictable */
+      int flip = (base_src == base_tgt) & src_offset & (tgt_offset ^ 1);
+      assert (base_src <= base_tgt);
+      src_offset ^= flip;
+      tgt_offset ^= flip;
+      nverts /= 2;
+      ++level;
+      base_src += nverts * src_offset;
+      base_tgt += nverts * tgt_offset;
+    }
+  }
+  PROFILE_END(bernoulli, t_bernoulli);
+  PROFILE_START(t_scramble);
+  int64_t src = scramble(base_src, lgN, val0, val1);
+  int64_t tgt = scramble(base_tgt, lgN, val0, val1);
+  PROFILE_END(scramble, t_scramble);
+  PROFILE_START(t_store);
+  write_edge(result, src, tgt);
+  PROFILE_END(store, t_store);
+}
+
+/* Counter-based alternative to make_one_edge: the draws for edge ei are the
+ * words of philox4x32_10((ei, j, 0), key) for j = 0, 1, ... in order, and its
+ * weight comes from counter (ei, 0, 1), so an edge depends only on the key
+ * and ei. */
+static ALWAYS_INLINE
+void make_one_edge_philox(int64_t nverts, int lgN, const uint32_t key[2], const initiator* init, uint64_t ei, packed_edge* result, float* weight, uint64_t val0, uint64_t val1) {
+  /* As generate_4way_bernoulli, but with 32-bit values. */
+  static const uint32_t limit = (uint32_t)((UINT64_C(1) << 32) % INITIATOR_DENOMINATOR);
+  uint32_t ctr[4] = {(uint32_t)ei, (uint32_t)(ei >> 32), 0, 0};
+  uint32_t rand[4];
+  int avail = 0;
+  int level = 0;
+  int64_t base_src = 0, base_tgt = 0;
+  PROFILE_START(t_bernoulli);
+  while (nverts > 1) {
+    uint32_t val;
+    PROFILE_COUNT(draws, 1);
+    while (1) {
+      if (avail == 0) {
+        philox4x32_10(ctr, key, rand);
+        ++ctr[2];
+        avail = 4;
+      }
+      val = rand[4 - avail--];
+      if (/* Likely */ val >= limit) break;
+      PROFILE_COUNT(rejections, 1);
+    }
+    int square = choose_quadrant(val % INITIATOR_DENOMINATOR, level, lgN, init);
+    int src_offset = square / 2;
+    int tgt_offset = square % 2;
+    if (base_src == base_tgt) {
+      /* Clip-and-flip for undirected graph */
+      if (src_offset > tgt_offset) {
+        int temp = src_offset;
+        src_offset = tgt_offset;
+        tgt_offset = temp;
+      }
+    }
+    nverts /= 2;
+    ++level;
+    base_src += nverts * src_offset;
+    base_tgt += nverts * tgt_offset;
+  }
+  PROFILE_END(bernoulli, t_bernoulli);
+  PROFILE_START(t_scramble);
+  int64_t src = scramble(base_src, lgN, val0, val1);
+  int64_t tgt = scramble(base_tgt, lgN, val0, val1);
+  PROFILE_END(scramble, t_scramble);
+  PROFILE_START(t_store);
+  write_edge(result, src, tgt);
+  PROFILE_END(store, t_store);
+  if (weight) {
+    PROFILE_START(t_weights);
+    ctr[2] = 0;
+    ctr[3] = 1;
+    philox4x32_10(ctr, key, rand);
+    *weight = (float)(rand[0] >> 8) * (1.0f / 16777216.0f); /* [0, 1) */
+    PROFILE_END(weights, t_weights);
+  }
+}
+
+int kronecker_options_valid(const kronecker_options* options) {
+  if (!options) return 1;
+  int a = options->initiator_a, b = options->initiator_b, c = options->initiator_c;
+  int noise = options->noise_level;
+  if (!a && !b && !c) {
+    a = INITIATOR_A_NUMERATOR;
+    b = c = INITIATOR_BC_NUMERATOR;
+  }
+  if (a < 0 || b < 0 || c < 0 || noise < 0) return 0;
+  if (a + b + c > INITIATOR_DENOMINATOR) return 0;
+  /* b and c range over [b - noise, b + noise) across levels. */
+  if (noise > b || noise > c || b + c + 2 * noise > INITIATOR_DENOMINATOR) return 0;
+  if (options->levels_per_draw < 0 || options->levels_per_draw > KRONECKER_MAX_LEVELS_PER_DRAW) return 0;
+  return 1;
+}
+
+/* Fill in init from options and return it, or return NULL if options select
+ * the compile-time initiator. */
+static const initiator* setup_initiator(const kronecker_options* options, int logN, initiator* init) {
+  if (!options || (!options->initiator_a && !options->initiator_b && !options->initiator_c && !options->noise_level)) {
+    return NULL;
+  }
+  uint32_t a = (uint32_t)options->initiator_a, b = (uint32_t)options->initiator_b, c = (uint32_t)options->initiator_c;
+  if (!a && !b && !c) {
+    a = INITIATOR_A_NUMERATOR;
+    b = c = INITIATOR_BC_NUMERATOR;
+  }
+  int noise = options->noise_level;
+  if (a == INITIATOR_A_NUMERATOR && b == INITIATOR_BC_NUMERATOR && c == INITIATOR_BC_NUMERATOR && noise == SPK_NOISE_LEVEL) {
+    return NULL;
+  }
+  assert (kronecker_options_valid(options));
+  assert (logN <= MAX_LEVELS);
+  int level;
+  for (level = 0; level < logN; ++level) {
+    /* As SPK_NOISE_LEVEL, but a and d keep their ratio as in Seshadhri et
+     * al.: a' = a * (1 - b' - c') / (1 - b - c). */
+    int f = noise ? 2 * noise * level / logN - noise : 0;
+    uint32_t bl = (uint32_t)((int)b + f), cl = (uint32_t)((int)c + f);
+    uint32_t al = a;
+    if (noise && b + c < INITIATOR_DENOMINATOR) {
+      al = (uint32_t)((uint64_t)a * (INITIATOR_DENOMINATOR - bl - cl) / (INITIATOR_DENOMINATOR - b - c));
+    }
+    init->t[level][0] = bl;
+    init->t[level][1] = bl + cl;
+    init->t[level][2] = bl + cl + al;
+  }
+  init->noise = noise;
+  return init;
+}
+
+/* Thresholds for the vector kernels, which need the same initiator at every
+ * level; returns 0 if they cannot be used. */
+static int set_simd_thresholds(kronecker_simd_params* params, const initiator* init) {
+  if (init) {
+    params->t1 = init->t[0][0];
+    params->t2 = init->t[0][1];
+    params->t3 = init->t[0][2];
+    return !init->noise;
+  }
+  params->t1 = INITIATOR_BC_NUMERATOR;
+  params->t2 = 2 * INITIATOR_BC_NUMERATOR;
+  params->t3 = 2 * INITIATOR_BC_NUMERATOR + INITIATOR_A_NUMERATOR;
+  return SPK_NOISE_LEVEL == 0;
+}
+
+/* Philox version of generate_kronecker_range_weighted.  The key and the
+ * scrambling values are derived from the seed with Philox as well, so no MRG
+ * state or skip table is involved. */
+static void generate_kronecker_range_philox(
+       const uint_fast32_t seed[5],
+       int logN,
+       int64_t start_edge, int64_t end_edge,
+       packed_edge* edges,
+       float* weights,
+       const initiator* init) {
+  int64_t nverts = (int64_t)1 << logN;
+  uint32_t key[2];
+  uint64_t val0, val1; /* Values for scrambling */
+  {
+    uint32_t ctr[4] = {(uint32_t)seed[0], (uint32_t)seed[1], (uint32_t)seed[2], (uint32_t)seed[3]};
+    uint32_t seed_key[2] = {(uint32_t)seed[4], 0};
+    uint32_t rand[4];
+    philox4x32_10(ctr, seed_key, rand);
+    key[0] = rand[0];
+    key[1] = rand[1];
+    uint32_t scramble_ctr[4] = {0, 0, 0, 2};
+    philox4x32_10(scramble_ctr, key, rand);
+    val0 = ((uint64_t)rand[0] << 32) | rand[1];
+    val1 = ((uint64_t)rand[2] << 32) | rand[3];
+  }
+
+  /* The vector kernels implement the noise-free quadrant selection only. */
+  kronecker_simd_params params;
+  params.limit = (uint32_t)((UINT64_C(1) << 32) % INITIATOR_DENOMINATOR);
+  params.div.d = INITIATOR_DENOMINATOR;
+  params.levels_per_draw = 1;
+  kronecker_philox_batch_fn batch = set_simd_thresholds(&params, init) ? kronecker_select_philox_batch(&params) : NULL;
+
+  int64_t ei;
+#ifdef _OPENMP
+#pragma omp parallel private(ei)
+#endif
+  {
+    int64_t nchunks = 1, chunk = 0;
+#ifdef _OPENMP
+    nchunks = omp_get_num_threads();
+    chunk = omp_get_thread_num();
+#endif
+    int64_t count = end_edge - start_edge;
+    int64_t my_start = start_edge + count * chunk / nchunks;
+    int64_t my_end = start_edge + count * (chunk + 1) / nchunks;
+#ifdef GENERATOR_PROFILE
+    profile_slot = (profile_slots && chunk < profile_nslots) ? &profile_slots[chunk].p : NULL;
+    PROFILE_COUNT(edges, (uint64_t)(my_end - my_start));
+#endif
+    ei = my_start;
+    if (batch) {
+      for (; ei + KRONECKER_BATCH <= my_end; ei += KRONECKER_BATCH) {
+        PROFILE_START(t_batch);
+        int ok = batch((uint64_t)ei, key, logN, val0, val1, &params, edges + (ei - start_edge),
+                       weights ? weights + (ei - start_edge) : NULL);
+        PROFILE_END(batch, t_batch);
+        if (/* Unlikely */ !ok) {
+          int k;
+          for (k = 0; k < KRONECKER_BATCH; ++k) {
+            make_one_edge_philox(nverts, logN, key, init, (uint64_t)(ei + k), edges + (ei + k - start_edge),
+                                 weights ? weights + (ei + k - start_edge) : NULL, val0, val1);
+          }
+        }
+      }
+    }
+    for (; ei < my_end; ++ei) {
+      if (init) {
+        make_one_edge_philox(nverts, logN, key, init, (uint64_t)ei, edges + (ei - start_edge),
+                             weights ? weights + (ei - start_edge) : NULL, val0, val1);
+      } else {
+        make_one_edge_philox(nverts, logN, key, NULL, (uint64_t)ei, edges + (ei - start_edge),
+                             weights ? weights + (ei - start_edge) : NULL, val0, val1);
+      }
+    }
+#ifdef GENERATOR_PROFILE
+    profile_slot = NULL;
+#endif
+  }
 }
 
 /* Generate a range of edges (from start_edge to end_edge of the total graph),
@@ -179,9 +564,34 @@ void generate_kronecker_range(
        , float* weights
 #endif
        ) {
+#ifdef SSSP
+  generate_kronecker_range_weighted(seed, logN, start_edge, end_edge, edges, weights, NULL);
+#else
+  generate_kronecker_range_weighted(seed, logN, start_edge, end_edge, edges, NULL, NULL);
+#endif
+}
+
+/* The weight of an edge is the next value of its MRG stream after the edge
+ * itself, so skipping weights (weights == NULL) does not change the edges. */
+void generate_kronecker_range_weighted(
+       const uint_fast32_t seed[5] /* All values in [0, 2^31 - 1), not all zero */,
+       int logN /* In base 2 */,
+       int64_t start_edge, int64_t end_edge,
+       packed_edge* edges,
+       float* weights,
+       const kronecker_options* options) {
+  initiator custom_init;
+  const initiator* init = setup_initiator(options, logN, &custom_init);
+  if (options && options->prng == KRONECKER_PRNG_PHILOX) {
+    generate_kronecker_range_philox(seed, logN, start_edge, end_edge, edges, weights, init);
+    return;
+  }
+
   mrg_state state;
   int64_t nverts = (int64_t)1 << logN;
   int64_t ei;
+  int levels_per_draw = options && options->levels_per_draw > 1 ? options->levels_per_draw : 1;
+  if (levels_per_draw > KRONECKER_MAX_LEVELS_PER_DRAW) levels_per_draw = KRONECKER_MAX_LEVELS_PER_DRAW;
 
   mrg_seed(&state, seed);
 
@@ -197,20 +607,103 @@ void generate_kronecker_range(
     val1 += mrg_get_uint_orig(&new_state);
   }
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
 #ifdef __MTA__
 #pragma mta assert parallel
 #pragma mta block schedule
-#endif
   for (ei = start_edge; ei < end_edge; ++ei) {
     mrg_state new_state = state;
     mrg_skip(&new_state, 0, (uint64_t)ei, 0);
-    make_one_edge(nverts, 0, logN, &new_state, edges + (ei - start_edge), val0, val1);
-#ifdef SSSP
-    weights[ei-start_edge]=mrg_get_float_orig(&new_state);
+    if (levels_per_draw > 1) {
+      make_one_edge_multilevel(nverts, logN, levels_per_draw, &new_state, init, edges + (ei - start_edge), val0, val1);
+    } else {
+      make_one_edge(nverts, 0, logN, &new_state, init, edges + (ei - start_edge), val0, val1);
+    }
+    if (weights) weights[ei-start_edge]=mrg_get_float_orig(&new_state);
+  }
+#else
+  /* Edge ei uses the stream skipped ahead by ei * 2^64 steps.  Rather than
+   * skipping from the seed for every edge, each thread skips once to the start
+   * of its contiguous range and then steps by 2^64 (a single matrix product,
+   * mrg_skip(st, 0, 1, 0)) per edge; the states are identical. */
+  /* The vector kernels implement the noise-free quadrant selection only,
+   * with one or two levels per draw. */
+  kronecker_simd_params params;
+  params.limit = UINT32_C(0x7FFFFFFF) % INITIATOR_DENOMINATOR;
+  params.div.d = INITIATOR_DENOMINATOR;
+  params.levels_per_draw = levels_per_draw;
+  params.pair_div.d = INITIATOR_DENOMINATOR * INITIATOR_DENOMINATOR;
+  params.pair_limit = UINT32_C(0x7FFFFFFF) % params.pair_div.d;
+  kronecker_batch_fn batch = set_simd_thresholds(&params, init) && levels_per_draw <= 2 ? kronecker_select_batch(&params) : NULL;
+
+#ifdef _OPENMP
+#pragma omp parallel private(ei)
+#endif
+  {
+    int64_t nchunks = 1, chunk = 0;
+#ifdef _OPENMP
+    nchunks = omp_get_num_threads();
+    chunk = omp_get_thread_num();
+#endif
+    int64_t count = end_edge - start_edge;
+    int64_t my_start = start_edge + count * chunk / nchunks;
+    int64_t my_end = start_edge + count * (chunk + 1) / nchunks;
+#ifdef GENERATOR_PROFILE
+    profile_slot = (profile_slots && chunk < profile_nslots) ? &profile_slots[chunk].p : NULL;
+    PROFILE_COUNT(edges, (uint64_t)(my_end - my_start));
+#endif
+    PROFILE_START(t_skip);
+    mrg_state edge_state = state;
+    mrg_skip(&edge_state, 0, (uint64_t)my_start, 0);
+    PROFILE_END(skip, t_skip);
+    ei = my_start;
+    if (batch) {
+      mrg_state lanes[KRONECKER_BATCH];
+      for (; ei + KRONECKER_BATCH <= my_end; ei += KRONECKER_BATCH) {
+        int k;
+        PROFILE_START(t_lanes);
+        for (k = 0; k < KRONECKER_BATCH; ++k) {
+          lanes[k] = edge_state;
+          mrg_skip(&edge_state, 0, 1, 0);
+        }
+        PROFILE_END(skip, t_lanes);
+        PROFILE_START(t_batch);
+        batch(lanes, logN, val0, val1, &params, edges + (ei - start_edge));
+        PROFILE_END(batch, t_batch);
+        if (weights) {
+          PROFILE_START(t_weights);
+          for (k = 0; k < KRONECKER_BATCH; ++k) {
+            weights[ei-start_edge+k]=mrg_get_float_orig(&lanes[k]);
+          }
+          PROFILE_END(weights, t_weights);
+        }
+      }
+    }
+    for (; ei < my_end; ++ei) {
+      mrg_state new_state = edge_state;
+      /* Separate calls so that the default initiator is compiled in */
+      if (levels_per_draw > 1) {
+        if (init) {
+          make_one_edge_multilevel(nverts, logN, levels_per_draw, &new_state, init, edges + (ei - start_edge), val0, val1);
+        } else {
+          make_one_edge_multilevel(nverts, logN, levels_per_draw, &new_state, NULL, edges + (ei - start_edge), val0, val1);
+        }
+      } else if (init) {
+        make_one_edge(nverts, 0, logN, &new_state, init, edges + (ei - start_edge), val0, val1);
+      } else {
+        make_one_edge(nverts, 0, logN, &new_state, NULL, edges + (ei - start_edge), val0, val1);
+      }
+      if (weights) {
+        PROFILE_START(t_weights);
+        weights[ei-start_edge]=mrg_get_float_orig(&new_state);
+        PROFILE_END(weights, t_weights);
+      }
+      PROFILE_START(t_step);
+      mrg_skip(&edge_state, 0, 1, 0);
+      PROFILE_END(skip, t_step);
+    }
+#ifdef GENERATOR_PROFILE
+    profile_slot = NULL;
 #endif
   }
+#endif
 }
-
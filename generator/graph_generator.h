@@ -82,6 +82,73 @@ void generate_kronecker_range(
 #endif
 );
 
+/* Random number generators for kronecker_options.prng. */
+#define KRONECKER_PRNG_MRG 0    /* Splittable MRG, as the Graph500 specification (default) */
+#define KRONECKER_PRNG_PHILOX 1 /* Counter-based Philox4x32-10: a different graph from the
+                                   same seed, but each edge is a pure function of (seed, index) */
+
+/* Generator settings beyond the specification defaults; all zero means the
+ * defaults. */
+typedef struct kronecker_options {
+  int prng; /* KRONECKER_PRNG_* */
+  /* Recursion levels decided by each accepted random draw, from 1 to
+   * KRONECKER_MAX_LEVELS_PER_DRAW (0 or 1: one per draw, as the
+   * specification).  More levels per draw give a different graph from the
+   * same seed, with the same edge distribution.  MRG only; ignored by Philox,
+   * whose draws are already cheap. */
+  int levels_per_draw;
+  /* Initiator probabilities a (top left), b (top right) and c (bottom left)
+   * in 1/KRONECKER_INITIATOR_DENOMINATOR units, d is the rest; all zero means
+   * the specification's 0.57, 0.19, 0.19.  b and c may differ, although
+   * clip-and-flip still mirrors the blocks on the diagonal. */
+  int initiator_a, initiator_b, initiator_c;
+  /* Noise of Seshadhri, Pinar and Kolda in the same units: b and c grow
+   * linearly from b - noise_level to b + noise_level over the levels, a and d
+   * keep their ratio.  0 for none. */
+  int noise_level;
+} kronecker_options;
+
+#define KRONECKER_MAX_LEVELS_PER_DRAW 4
+#define KRONECKER_INITIATOR_DENOMINATOR 10000
+
+/* 1 if the options are usable (probabilities in range, noise_level at most
+ * b and c, and b + c + 2 * noise_level at most 1), 0 otherwise. */
+int kronecker_options_valid(const kronecker_options* options);
+
+/* Same as generate_kronecker_range, but available without SSSP: if weights is
+ * not NULL, it also receives the SSSP edge weights (in [0, 1)) that
+ * generate_kronecker_range produces under SSSP for the same edges.  With
+ * options == NULL the edges are those of generate_kronecker_range. */
+void generate_kronecker_range_weighted(
+       const uint_fast32_t seed[5] /* All values in [0, 2^31 - 1) */,
+       int logN /* In base 2 */,
+       int64_t start_edge, int64_t end_edge /* Indices (in [0, M)) for the edges to generate */,
+       packed_edge* edges /* Size >= end_edge - start_edge */,
+       float* weights /* NULL, or size >= end_edge - start_edge */,
+       const kronecker_options* options /* NULL for the defaults */);
+
+#ifdef GENERATOR_PROFILE
+/* Time spent in each stage of generate_kronecker_range_weighted, in ticks of
+ * the cycle counter (nanoseconds where there is none), summed over threads.
+ * Only available when the generator is built with -DGENERATOR_PROFILE. */
+typedef struct kronecker_profile {
+  uint64_t skip;      /* mrg_skip to each edge's stream */
+  uint64_t bernoulli; /* Quadrant draws, including rejected values */
+  uint64_t scramble;  /* Vertex number scrambling */
+  uint64_t store;     /* write_edge */
+  uint64_t batch;     /* Vector kernel (all of the above but skip) */
+  uint64_t weights;   /* SSSP weights */
+  uint64_t edges;     /* Edges generated */
+  uint64_t draws;     /* Quadrant draws by the scalar code */
+  uint64_t rejections; /* Values redrawn by generate_4way_bernoulli */
+} kronecker_profile;
+
+/* Start counting for all later calls, from zero. */
+void kronecker_profile_start(void);
+/* Stop counting and return the totals since kronecker_profile_start. */
+void kronecker_profile_stop(kronecker_profile* total);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "user_settings.h"
+#include "splittable_mrg.h"
+#include "graph_generator.h"
+#include "graph_generator_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+/* AVX2: two vectors of four lanes per batch. */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#define VEC __m256i
+#define MASK __m256i
+#define LANES 4
+#define SIMD_FN(name) name##_avx2
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define V_SET1(x) _mm256_set1_epi64x((long long)(x))
+#define V_BYTES16(...) _mm256_broadcastsi128_si256(_mm_setr_epi8(__VA_ARGS__))
+#define V_ADD _mm256_add_epi64
+#define V_SUB _mm256_sub_epi64
+#define V_AND _mm256_and_si256
+#define V_OR _mm256_or_si256
+#define V_XOR _mm256_xor_si256
+#define V_SRLI _mm256_srli_epi64
+#define V_SRL(v, n) _mm256_srl_epi64((v), _mm_cvtsi32_si128(n))
+#define V_MUL32 _mm256_mul_epu32
+#define V_MULLO64 mullo64_avx2
+#define V_SHUFFLE8 _mm256_shuffle_epi8
+#define V_LT(a, b) _mm256_cmpgt_epi64((b), (a))
+#define V_EQ _mm256_cmpeq_epi64
+#define M_AND _mm256_and_si256
+#define M_OR _mm256_or_si256
+#define M_ANDNOT(a, b) _mm256_andnot_si256((b), (a))
+#define M_ANY(m) (!_mm256_testz_si256((m), (m)))
+#define V_SELECT(m, a, b) _mm256_blendv_epi8((b), (a), (m))
+#define V_MASKED(m, v) _mm256_and_si256((m), (v))
+
+/* AVX2 has no 64-bit multiply; build it from 32x32->64 products. */
+static inline __m256i mullo64_avx2(__m256i a, __m256i b) {
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                   _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+  return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+#include "graph_generator_simd_kernel.h"
+
+#undef VEC
+#undef MASK
+#undef LANES
+#undef SIMD_FN
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_BYTES16
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_OR
+#undef V_XOR
+#undef V_SRLI
+#undef V_SRL
+#undef V_MUL32
+#undef V_MULLO64
+#undef V_SHUFFLE8
+#undef V_LT
+#undef V_EQ
+#undef M_AND
+#undef M_OR
+#undef M_ANDNOT
+#undef M_ANY
+#undef V_SELECT
+#undef V_MASKED
+
+#pragma GCC pop_options
+
+/* AVX-512: one vector of eight lanes per batch, with mask registers. */
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq")
+
+#define VEC __m512i
+#define MASK __mmask8
+#define LANES 8
+#define SIMD_FN(name) name##_avx512
+#define V_LOAD(p) _mm512_loadu_si512((const void*)(p))
+#define V_STORE(p, v) _mm512_storeu_si512((void*)(p), (v))
+#define V_SET1(x) _mm512_set1_epi64((long long)(x))
+#define V_BYTES16(...) _mm512_broadcast_i32x4(_mm_setr_epi8(__VA_ARGS__))
+#define V_ADD _mm512_add_epi64
+#define V_SUB _mm512_sub_epi64
+#define V_AND _mm512_and_si512
+#define V_OR _mm512_or_si512
+#define V_XOR _mm512_xor_si512
+#define V_SRLI _mm512_srli_epi64
+#define V_SRL(v, n) _mm512_srl_epi64((v), _mm_cvtsi32_si128(n))
+#define V_MUL32 _mm512_mul_epu32
+#define V_MULLO64 _mm512_mullo_epi64
+#define V_SHUFFLE8 _mm512_shuffle_epi8
+#define V_LT _mm512_cmplt_epu64_mask
+#define V_EQ _mm512_cmpeq_epu64_mask
+#define M_AND(a, b) ((__mmask8)((a) & (b)))
+#define M_OR(a, b) ((__mmask8)((a) | (b)))
+#define M_ANDNOT(a, b) ((__mmask8)((a) & ~(b)))
+#define M_ANY(m) ((m) != 0)
+#define V_SELECT(m, a, b) _mm512_mask_blend_epi64((m), (b), (a))
+#define V_MASKED(m, v) _mm512_maskz_mov_epi64((m), (v))
+
+#include "graph_generator_simd_kernel.h"
+
+#pragma GCC pop_options
+
+/* Round-up reciprocal for dividing values of nbits bits exactly (Granlund
+ * and Montgomery), after shifting out the divisor's factors of two; the
+ * kernels need the multiplier to fit in 32 bits.  Returns 0 if it does not. */
+static int set_division(kronecker_divisor* div, int nbits) {
+  uint32_t d = div->d;
+  if (d == 0) return 0;
+  int pre = 0;
+  while (!(d & 1)) {
+    d >>= 1;
+    ++pre;
+  }
+  int l = 0;
+  while (((uint64_t)1 << l) < d) ++l;
+  div->pre_shift = pre;
+  div->shift = nbits - pre + l;
+  div->multiplier = (((uint64_t)1 << div->shift) + d - 1) / d;
+  return div->multiplier <= UINT32_MAX;
+}
+
+/* 2 for AVX-512, 1 for AVX2, 0 for neither (or disabled). */
+static int simd_level(void) {
+  const char* env = getenv("GENERATOR_SIMD");
+  int allow_avx512 = 1;
+  if (env) {
+    if (!strcmp(env, "0") || !strcmp(env, "scalar")) return 0;
+    if (!strcmp(env, "avx2")) allow_avx512 = 0;
+  }
+  __builtin_cpu_init();
+  if (allow_avx512 && __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")) {
+    return 2;
+  }
+  return __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+kronecker_batch_fn kronecker_select_batch(kronecker_simd_params* params) {
+  if (!set_division(&params->div, 31)) return NULL;
+  if (params->levels_per_draw == 2 && !set_division(&params->pair_div, 31)) return NULL;
+  switch (simd_level()) {
+    case 2: return make_edges_avx512;
+    case 1: return make_edges_avx2;
+    default: return NULL;
+  }
+}
+
+kronecker_philox_batch_fn kronecker_select_philox_batch(kronecker_simd_params* params) {
+  if (!set_division(&params->div, 32)) return NULL;
+  switch (simd_level()) {
+    case 2: return make_edges_philox_avx512;
+    case 1: return make_edges_philox_avx2;
+    default: return NULL;
+  }
+}
+
+#else
+
+kronecker_batch_fn kronecker_select_batch(kronecker_simd_params* params) {
+  (void)params;
+  return NULL;
+}
+
+kronecker_philox_batch_fn kronecker_select_philox_batch(kronecker_simd_params* params) {
+  (void)params;
+  return NULL;
+}
+
+#endif
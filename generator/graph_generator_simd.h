@@ -0,0 +1,68 @@
+#ifndef GRAPH_GENERATOR_SIMD_H
+#define GRAPH_GENERATOR_SIMD_H
+
+#include <stdint.h>
+#include "splittable_mrg.h"
+#include "graph_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vectorized versions of make_one_edge in graph_generator.c, used internally
+ * by generate_kronecker_range.  A batch kernel generates KRONECKER_BATCH
+ * edges at once, one per SIMD lane, and produces exactly the same edges as
+ * the scalar code. */
+#define KRONECKER_BATCH 8
+
+/* Quadrant selection for one recursion level: draw val (31 bits from the
+ * MRG, 32 from Philox), redraw while val < limit, then r = val % denominator
+ * picks quadrant 1 (r < t1), 2 (r < t2), 0 (r < t3) or 3, as
+ * generate_4way_bernoulli. */
+typedef struct kronecker_divisor {
+  uint32_t d;
+  /* val / d == ((val >> pre_shift) * multiplier) >> shift */
+  int pre_shift;
+  uint64_t multiplier;
+  int shift;
+} kronecker_divisor;
+
+typedef struct kronecker_simd_params {
+  uint32_t limit, t1, t2, t3;
+  kronecker_divisor div; /* div.d is the initiator denominator */
+  /* With levels_per_draw == 2 (MRG only), each draw below pair_limit is
+   * redrawn, and val % pair_div.d (the denominator squared) gives the
+   * values for two levels, most significant digit first. */
+  int levels_per_draw;
+  uint32_t pair_limit;
+  kronecker_divisor pair_div;
+} kronecker_simd_params;
+
+/* Generate edges from KRONECKER_BATCH per-edge MRG states (states[i] as it
+ * would be passed to make_one_edge); each state is left as make_one_edge
+ * would leave it. */
+typedef void (*kronecker_batch_fn)(mrg_state* states, int logN, uint64_t val0, uint64_t val1,
+                                   const kronecker_simd_params* params, packed_edge* result);
+
+/* Generate edges first_edge + i for i in [0, KRONECKER_BATCH) as
+ * make_one_edge_philox does, and their weights if weights is not NULL.
+ * Returns 0 without a usable result if some edge needs a redrawn value
+ * (probability below 1e-4 per batch); the caller then uses the scalar
+ * code. */
+typedef int (*kronecker_philox_batch_fn)(uint64_t first_edge, const uint32_t key[2], int logN,
+                                         uint64_t val0, uint64_t val1, const kronecker_simd_params* params,
+                                         packed_edge* result, float* weights);
+
+/* Fill in the divisor multipliers in params (div.d and, for pairs,
+ * pair_div.d must be set) and return the widest kernel the CPU supports, or
+ * NULL to use the scalar code.  Setting the environment variable
+ * GENERATOR_SIMD to "avx2" caps the choice at AVX2, and to "0" or "scalar"
+ * disables the vector kernels. */
+kronecker_batch_fn kronecker_select_batch(kronecker_simd_params* params);
+kronecker_philox_batch_fn kronecker_select_philox_batch(kronecker_simd_params* params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GRAPH_GENERATOR_SIMD_H */
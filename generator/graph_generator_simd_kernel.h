@@ -0,0 +1,228 @@
+/* Batch Kronecker edge kernel, included by graph_generator_simd.c once per
+ * instruction set with these macros defined:
+ *
+ *   VEC, MASK        vector of 64-bit lanes and lane mask types
+ *   LANES            lanes per VEC; KRONECKER_BATCH / LANES vectors are used
+ *   SIMD_FN(name)    per-instruction-set function name
+ *   V_LOAD(p), V_STORE(p, v), V_SET1(x)
+ *   V_BYTES16(...)   16 bytes repeated in each 128 bits
+ *   V_ADD, V_SUB, V_AND, V_OR, V_XOR   lane-wise 64-bit operations
+ *   V_SRLI(v, imm), V_SRL(v, n)        logical right shift
+ *   V_MUL32(a, b)    low 32 bits of a times low 32 bits of b, 64-bit result
+ *   V_MULLO64(a, b)  low 64 bits of a * b
+ *   V_SHUFFLE8(t, i) byte shuffle of table t by i within each 128 bits
+ *   V_LT(a, b), V_EQ(a, b)   lane masks (operands below 2^63)
+ *   M_AND, M_OR, M_ANDNOT(a, b) (a and not b), M_ANY(m)
+ *   V_SELECT(m, a, b)        a where m is set, b elsewhere
+ *   V_MASKED(m, v)           v where m is set, 0 elsewhere
+ *
+ * Every step mirrors the scalar code in graph_generator.c, splittable_mrg.c
+ * and philox.h lane by lane, so the results are bit-identical. */
+
+#define NVEC (KRONECKER_BATCH / LANES)
+
+/* x mod 2^31 - 1 for x < 2^62. */
+static inline VEC SIMD_FN(mod_p)(VEC x) {
+  const VEC p = V_SET1(0x7FFFFFFF);
+  x = V_ADD(V_AND(x, p), V_SRLI(x, 31));
+  x = V_ADD(V_AND(x, p), V_SRLI(x, 31));
+  return V_SELECT(V_LT(x, p), x, V_SUB(x, p));
+}
+
+/* mrg_orig_step for the lanes in m. */
+static inline void SIMD_FN(mrg_step)(VEC z[5], MASK m) {
+  VEC n = SIMD_FN(mod_p)(V_ADD(V_MUL32(z[0], V_SET1(107374182)), V_MUL32(z[4], V_SET1(104480))));
+  z[4] = V_SELECT(m, z[3], z[4]);
+  z[3] = V_SELECT(m, z[2], z[3]);
+  z[2] = V_SELECT(m, z[1], z[2]);
+  z[1] = V_SELECT(m, z[0], z[1]);
+  z[0] = V_SELECT(m, n, z[0]);
+}
+
+static inline VEC SIMD_FN(bitreverse)(VEC x) {
+  const VEC bswap = V_BYTES16(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const VEC rev_lo = V_BYTES16(0x00, (char)0x80, 0x40, (char)0xC0, 0x20, (char)0xA0, 0x60, (char)0xE0,
+                               0x10, (char)0x90, 0x50, (char)0xD0, 0x30, (char)0xB0, 0x70, (char)0xF0);
+  const VEC rev_hi = V_BYTES16(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+                               0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+  const VEC nibble = V_SET1(0x0F0F0F0F0F0F0F0FULL);
+  x = V_SHUFFLE8(x, bswap);
+  return V_OR(V_SHUFFLE8(rev_lo, V_AND(x, nibble)),
+              V_SHUFFLE8(rev_hi, V_AND(V_SRLI(x, 4), nibble)));
+}
+
+static inline VEC SIMD_FN(scramble)(VEC v, int lgN, uint64_t val0, uint64_t val1) {
+  v = V_ADD(v, V_SET1(val0 + val1));
+  v = V_MULLO64(v, V_SET1(val0 | UINT64_C(0x4519840211493211)));
+  v = V_SRL(SIMD_FN(bitreverse)(v), 64 - lgN);
+  v = V_MULLO64(v, V_SET1(val1 | UINT64_C(0x3050852102C843A5)));
+  v = V_SRL(SIMD_FN(bitreverse)(v), 64 - lgN);
+  return v;
+}
+
+/* val / div->d for val below 2^32. */
+static inline VEC SIMD_FN(divide)(VEC val, const kronecker_divisor* div) {
+  return V_SRL(V_MUL32(V_SRL(val, div->pre_shift), V_SET1(div->multiplier)), div->shift);
+}
+
+/* One recursion level for all lanes: pick quadrants from val % denominator
+ * (val already accepted) and descend, with clip-and-flip. */
+static inline void SIMD_FN(descend)(VEC val, VEC* src, VEC* tgt, VEC bit, const kronecker_simd_params* params) {
+  const VEC t1 = V_SET1(params->t1), t2 = V_SET1(params->t2), t3 = V_SET1(params->t3);
+  VEC r = V_SUB(val, V_MUL32(SIMD_FN(divide)(val, &params->div), V_SET1(params->div.d)));
+  MASK is1 = V_LT(r, t1);
+  MASK is2 = M_ANDNOT(V_LT(r, t2), is1);
+  MASK is3 = M_ANDNOT(V_EQ(r, r), V_LT(r, t3));
+
+  /* Clip-and-flip turns quadrant 2 into 1 on the diagonal. */
+  MASK diag = V_EQ(*src, *tgt);
+  MASK src_offset = M_OR(M_ANDNOT(is2, diag), is3);
+  MASK tgt_offset = M_OR(M_OR(is1, is3), M_AND(is2, diag));
+  *src = V_ADD(*src, V_MASKED(src_offset, bit));
+  *tgt = V_ADD(*tgt, V_MASKED(tgt_offset, bit));
+}
+
+static void SIMD_FN(make_edges)(mrg_state* states, int logN, uint64_t val0, uint64_t val1,
+                                const kronecker_simd_params* params, packed_edge* result) {
+  uint64_t lanes[5][KRONECKER_BATCH];
+  VEC z[NVEC][5], src[NVEC], tgt[NVEC];
+  int i, h;
+
+  for (i = 0; i < KRONECKER_BATCH; ++i) {
+    lanes[0][i] = states[i].z1;
+    lanes[1][i] = states[i].z2;
+    lanes[2][i] = states[i].z3;
+    lanes[3][i] = states[i].z4;
+    lanes[4][i] = states[i].z5;
+  }
+  for (h = 0; h < NVEC; ++h) {
+    for (i = 0; i < 5; ++i) z[h][i] = V_LOAD(lanes[i] + h * LANES);
+    src[h] = tgt[h] = V_SET1(0);
+  }
+
+  const VEC single_limit = V_SET1(params->limit), pair_limit = V_SET1(params->pair_limit);
+  const MASK all = V_EQ(single_limit, single_limit);
+
+  int64_t nverts = (int64_t)1 << logN;
+  int levels_left = logN;
+  while (levels_left > 0) {
+    int pair = params->levels_per_draw == 2 && levels_left >= 2;
+    const VEC limit = pair ? pair_limit : single_limit;
+    const VEC bit = V_SET1(nverts / 2), next_bit = V_SET1(nverts / 4);
+    for (h = 0; h < NVEC; ++h) {
+      /* generate_4way_bernoulli */
+      SIMD_FN(mrg_step)(z[h], all);
+      VEC val = z[h][0];
+      MASK redo = V_LT(val, limit);
+      while (/* Unlikely */ M_ANY(redo)) {
+        SIMD_FN(mrg_step)(z[h], redo);
+        val = V_SELECT(redo, z[h][0], val);
+        redo = M_AND(redo, V_LT(val, limit));
+      }
+      if (pair) {
+        /* make_one_edge_multilevel with two levels per draw */
+        VEC v = V_SUB(val, V_MUL32(SIMD_FN(divide)(val, &params->pair_div), V_SET1(params->pair_div.d)));
+        SIMD_FN(descend)(SIMD_FN(divide)(v, &params->div), &src[h], &tgt[h], bit, params);
+        SIMD_FN(descend)(v, &src[h], &tgt[h], next_bit, params);
+      } else {
+        SIMD_FN(descend)(val, &src[h], &tgt[h], bit, params);
+      }
+    }
+    nverts /= pair ? 4 : 2;
+    levels_left -= pair ? 2 : 1;
+  }
+
+  uint64_t out_src[KRONECKER_BATCH], out_tgt[KRONECKER_BATCH];
+  for (h = 0; h < NVEC; ++h) {
+    V_STORE(out_src + h * LANES, SIMD_FN(scramble)(src[h], logN, val0, val1));
+    V_STORE(out_tgt + h * LANES, SIMD_FN(scramble)(tgt[h], logN, val0, val1));
+    for (i = 0; i < 5; ++i) V_STORE(lanes[i] + h * LANES, z[h][i]);
+  }
+  for (i = 0; i < KRONECKER_BATCH; ++i) {
+    write_edge(result + i, (int64_t)out_src[i], (int64_t)out_tgt[i]);
+    states[i].z1 = lanes[0][i];
+    states[i].z2 = lanes[1][i];
+    states[i].z3 = lanes[2][i];
+    states[i].z4 = lanes[3][i];
+    states[i].z5 = lanes[4][i];
+  }
+}
+
+/* philox4x32_10 on 32-bit values held in 64-bit lanes. */
+static inline void SIMD_FN(philox)(VEC c[4], const uint32_t key[2]) {
+  const VEC m0 = V_SET1(UINT32_C(0xD2511F53)), m1 = V_SET1(UINT32_C(0xCD9E8D57));
+  const VEC low = V_SET1(UINT32_MAX);
+  uint32_t k0 = key[0], k1 = key[1];
+  int round;
+  for (round = 0; round < 10; ++round) {
+    VEC p0 = V_MUL32(c[0], m0);
+    VEC p1 = V_MUL32(c[2], m1);
+    c[0] = V_XOR(V_XOR(V_SRLI(p1, 32), c[1]), V_SET1(k0));
+    c[1] = V_AND(p1, low);
+    c[2] = V_XOR(V_XOR(V_SRLI(p0, 32), c[3]), V_SET1(k1));
+    c[3] = V_AND(p0, low);
+    k0 += UINT32_C(0x9E3779B9);
+    k1 += UINT32_C(0xBB67AE85);
+  }
+}
+
+static int SIMD_FN(make_edges_philox)(uint64_t first_edge, const uint32_t key[2], int logN,
+                                      uint64_t val0, uint64_t val1, const kronecker_simd_params* params,
+                                      packed_edge* result, float* weights) {
+  uint64_t index[KRONECKER_BATCH];
+  VEC ei[NVEC], src[NVEC], tgt[NVEC], rand[NVEC][4];
+  int i, h;
+
+  for (i = 0; i < KRONECKER_BATCH; ++i) index[i] = first_edge + (uint64_t)i;
+  for (h = 0; h < NVEC; ++h) {
+    ei[h] = V_LOAD(index + h * LANES);
+    src[h] = tgt[h] = V_SET1(0);
+  }
+
+  const VEC limit = V_SET1(params->limit);
+  const VEC low = V_SET1(UINT32_MAX);
+  MASK redo = V_LT(low, low);
+
+  int64_t nverts = (int64_t)1 << logN;
+  int level = 0;
+  while (nverts > 1) {
+    nverts /= 2;
+    const VEC bit = V_SET1(nverts);
+    for (h = 0; h < NVEC; ++h) {
+      if (level % 4 == 0) {
+        rand[h][0] = V_AND(ei[h], low);
+        rand[h][1] = V_SRLI(ei[h], 32);
+        rand[h][2] = V_SET1(level / 4);
+        rand[h][3] = V_SET1(0);
+        SIMD_FN(philox)(rand[h], key);
+      }
+      VEC val = rand[h][level % 4];
+      redo = M_OR(redo, V_LT(val, limit));
+      SIMD_FN(descend)(val, &src[h], &tgt[h], bit, params);
+    }
+    ++level;
+  }
+  if (/* Unlikely */ M_ANY(redo)) return 0;
+
+  uint64_t out_src[KRONECKER_BATCH], out_tgt[KRONECKER_BATCH], out_weight[KRONECKER_BATCH];
+  for (h = 0; h < NVEC; ++h) {
+    V_STORE(out_src + h * LANES, SIMD_FN(scramble)(src[h], logN, val0, val1));
+    V_STORE(out_tgt + h * LANES, SIMD_FN(scramble)(tgt[h], logN, val0, val1));
+    if (weights) {
+      VEC c[4] = {V_AND(ei[h], low), V_SRLI(ei[h], 32), V_SET1(0), V_SET1(1)};
+      SIMD_FN(philox)(c, key);
+      V_STORE(out_weight + h * LANES, c[0]);
+    }
+  }
+  for (i = 0; i < KRONECKER_BATCH; ++i) {
+    write_edge(result + i, (int64_t)out_src[i], (int64_t)out_tgt[i]);
+  }
+  if (weights) {
+    for (i = 0; i < KRONECKER_BATCH; ++i) {
+      weights[i] = (float)(out_weight[i] >> 8) * (1.0f / 16777216.0f);
+    }
+  }
+  return 1;
+}
+
+#undef NVEC
@@ -0,0 +1,32 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+
+/* Philox4x32-10 counter-based random number generator from J. K. Salmon et
+ * al., "Parallel random numbers: as easy as 1, 2, 3" (SC11).  Each call maps
+ * a 128-bit counter and a 64-bit key to 128 random bits, so any position of
+ * the stream can be reached directly, without the skip tables the MRG
+ * needs. */
+
+static inline void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  int round;
+  for (round = 0; round < 10; ++round) {
+    uint64_t p0 = (uint64_t)UINT32_C(0xD2511F53) * c0;
+    uint64_t p1 = (uint64_t)UINT32_C(0xCD9E8D57) * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += UINT32_C(0x9E3779B9);
+    k1 += UINT32_C(0xBB67AE85);
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+#endif /* PHILOX_H */
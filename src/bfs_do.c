@@ -0,0 +1,227 @@
+/* Copyright (c) 2011-2017 Graph500 Steering Committee
+   All rights reserved.
+   Developed by:		Anton Korzh anton@korzh.us
+				Graph500 Steering Committee
+				http://www.graph500.org
+   New code under University of Illinois/NCSA Open Source License
+   see license.txt or https://opensource.org/licenses/NCSA
+*/
+
+// Graph500: Kernel 2: BFS
+// Direction-optimizing BFS (Beamer, Asanovic, Patterson): top-down levels
+// send visits as Active Messages as in bfs_reference.c, bottom-up levels let
+// every unvisited vertex look for a parent in a replicated frontier bitmap
+
+#include "common.h"
+#include "aml.h"
+#include "csr_reference.h"
+#include "bitmap_reference.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <stdint.h>
+
+// Switch to bottom-up when the frontier has more than 1/ALPHA of the edges
+// of the unvisited vertices, back to top-down when it has fewer than
+// 1/BETA of all vertices and shrinks
+#ifndef DO_BFS_ALPHA
+#define DO_BFS_ALPHA 14
+#endif
+#ifndef DO_BFS_BETA
+#define DO_BFS_BETA 24
+#endif
+
+#ifdef DEBUGSTATS
+extern int64_t nbytes_sent,nbytes_rcvd;
+#endif
+// two arrays holding visited VERTEX_LOCALs for current and next level
+// we swap pointers each time
+int *q1,*q2;
+int qc,q2c; //pointer to first free element
+
+//VISITED bitmap parameters
+unsigned long *visited;
+int64_t visited_size;
+
+//frontier bitmap of this rank and of all ranks, rank r's words at r*frontier_words
+unsigned long *frontier,*global_frontier;
+int64_t frontier_words;
+#define TEST_FRONTIER(v) ((global_frontier[VERTEX_OWNER((v)) * frontier_words + (VERTEX_LOCAL((v)) ulong_shift)] >> (VERTEX_LOCAL((v)) ulong_mask)) & 1)
+
+//global variables of CSR graph to be used inside of AM-handlers
+int64_t *column;
+int64_t *pred_glob;
+unsigned int * rowstarts;
+
+oned_csr_graph g;
+
+typedef struct visitmsg {
+	//both vertexes are VERTEX_LOCAL components as we know src and dest PEs to reconstruct VERTEX_GLOBAL
+	int vloc;
+	int vfrom;
+} visitmsg;
+
+//AM-handler for check&visit
+void visithndl(int from,void* data,int sz) {
+	visitmsg *m = data;
+	if (!TEST_VISITEDLOC(m->vloc)) {
+		SET_VISITEDLOC(m->vloc);
+		q2[q2c++] = m->vloc;
+		pred_glob[m->vloc] = VERTEX_TO_GLOBAL(from,m->vfrom);
+	}
+}
+
+inline void send_visit(int64_t glob, int from) {
+	visitmsg m = {VERTEX_LOCAL(glob),from};
+	aml_send(&m,1,sizeof(visitmsg),VERTEX_OWNER(glob));
+}
+
+void make_graph_data_structure(const tuple_graph* const tg) {
+	int i;
+	convert_graph_to_oned_csr(tg, &g);
+	column=g.column;
+	rowstarts=g.rowstarts;
+
+	visited_size = (g.nlocalverts + ulong_bits - 1) / ulong_bits;
+	aml_register_handler(visithndl,1);
+	q1 = xmalloc(g.nlocalverts*sizeof(int)); //100% of vertexes
+	q2 = xmalloc(g.nlocalverts*sizeof(int));
+	for(i=0;i<g.nlocalverts;i++) q1[i]=0,q2[i]=0; //touch memory
+	visited = xmalloc(visited_size*sizeof(unsigned long));
+
+	frontier_words = visited_size;
+	aml_long_allmax(&frontier_words);
+	frontier = xcalloc(frontier_words,sizeof(unsigned long));
+	global_frontier = xcalloc(frontier_words*num_pes(),sizeof(unsigned long));
+}
+
+// top-down level: send visit AMs to all neighbours of the frontier
+static void top_down_level(void) {
+	unsigned int i,j;
+	for(i=0;i<qc;i++)
+		for(j=rowstarts[q1[i]];j<rowstarts[q1[i]+1];j++)
+			send_visit(COLUMN(j),q1[i]);
+	aml_barrier();
+}
+
+// bottom-up level: every unvisited local vertex takes the first neighbour
+// found in the frontier as its parent, no messages besides the allgather
+static void bottom_up_level(void) {
+	size_t i,w;
+	unsigned int j;
+	memset(frontier,0,frontier_words*sizeof(unsigned long));
+	for(i=0;i<qc;i++) frontier[q1[i] ulong_shift] |= 1UL << (q1[i] ulong_mask);
+	MPI_Allgather(frontier,frontier_words,MPI_UNSIGNED_LONG,global_frontier,frontier_words,MPI_UNSIGNED_LONG,MPI_COMM_WORLD);
+
+	for(w=0;w<visited_size;w++) {
+		if(visited[w]==~0UL) continue;
+		size_t end = (w+1)*ulong_bits < g.nlocalverts ? (w+1)*ulong_bits : g.nlocalverts;
+		for(i=w*ulong_bits;i<end;i++) {
+			if(TEST_VISITEDLOC(i)) continue;
+			for(j=rowstarts[i];j<rowstarts[i+1];j++) {
+				int64_t u=COLUMN(j);
+				if(TEST_FRONTIER(u)) {
+					pred_glob[i]=u;
+					SET_VISITEDLOC(i);
+					q2[q2c++]=i;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void run_bfs(int64_t root, int64_t* pred) {
+	int64_t nvisited;
+	unsigned int i;
+	int bottom_up=0;
+#ifdef DEBUGSTATS
+	unsigned int lvl=1;
+#endif
+	pred_glob=pred;
+	aml_register_handler(visithndl,1);
+
+	CLEAN_VISITED();
+
+	qc=0; q2c=0;
+
+	nvisited=0;
+	if(VERTEX_OWNER(root) == rank) {
+		pred[VERTEX_LOCAL(root)]=root;
+		SET_VISITED(root);
+		q1[0]=VERTEX_LOCAL(root);
+		qc=1;
+	}
+
+	// edges out of unvisited vertices, global n_f of the previous level
+	long edges_unvisited=g.nlocaledges;
+	long prev_nf=0;
+
+	while(1) {
+		// n_f, m_f and m_u of Beamer's heuristic in one allreduce
+		long counts[3]={qc,0,0};
+		for(i=0;i<qc;i++) counts[1]+=rowstarts[q1[i]+1]-rowstarts[q1[i]];
+		edges_unvisited-=counts[1];
+		counts[2]=edges_unvisited;
+		MPI_Allreduce(MPI_IN_PLACE,counts,3,MPI_LONG,MPI_SUM,MPI_COMM_WORLD);
+		if(!counts[0]) break;
+		nvisited+=counts[0];
+
+		if(!bottom_up && counts[1] > counts[2] / DO_BFS_ALPHA && counts[0] > prev_nf)
+			bottom_up=1;
+		else if(bottom_up && counts[0] < g.nglobalverts / DO_BFS_BETA && counts[0] < prev_nf)
+			bottom_up=0;
+		prev_nf=counts[0];
+
+#ifdef DEBUGSTATS
+		double t0=aml_time();
+		nbytes_sent=0; nbytes_rcvd=0;
+#endif
+		if(bottom_up) bottom_up_level();
+		else top_down_level();
+
+		qc=q2c;int *tmp=q1;q1=q2;q2=tmp;
+		q2c=0;
+#ifdef DEBUGSTATS
+		aml_long_allsum(&nbytes_sent);
+		t0-=aml_time();
+		if(!my_pe()) printf (" --lvl%u %s: frontier %ld, %"PRId64" visited in %5.2fs, network aggr %5.2fGb/s\n",lvl++,bottom_up?"bottom-up":"top-down ",counts[0],nvisited,-t0,-(double)nbytes_sent*8.0/(1.e9*t0));
+#endif
+	}
+	aml_barrier();
+
+}
+
+//we need edge count to calculate teps. Validation will check if this count is correct
+void get_edge_count_for_teps(int64_t* edge_visit_count) {
+	long i,j;
+	long edge_count=0;
+	for(i=0;i<g.nlocalverts;i++)
+		if(pred_glob[i]!=-1) {
+			for(j=rowstarts[i];j<rowstarts[i+1];j++)
+				if(COLUMN(j)<=VERTEX_TO_GLOBAL(my_pe(),i))
+					edge_count++;
+
+		}
+
+	aml_long_allsum(&edge_count);
+	*edge_visit_count=edge_count;
+}
+
+void clean_pred(int64_t* pred) {
+	int i;
+	for(i=0;i<g.nlocalverts;i++) pred[i]=-1;
+}
+void free_graph_data_structure(void) {
+	free_oned_csr_graph(&g);
+	free(q1); free(q2); free(visited);
+	free(frontier); free(global_frontier);
+}
+
+size_t get_nlocalverts_for_pred(void) {
+	return g.nlocalverts;
+}
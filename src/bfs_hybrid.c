@@ -0,0 +1,277 @@
+/* Copyright (c) 2011-2017 Graph500 Steering Committee
+   All rights reserved.
+   Developed by:		Anton Korzh anton@korzh.us
+				Graph500 Steering Committee
+				http://www.graph500.org
+   New code under University of Illinois/NCSA Open Source License
+   see license.txt or https://opensource.org/licenses/NCSA
+*/
+
+// Graph500: Kernel 2: BFS
+// Hybrid MPI+OpenMP level-synchronized BFS, meant for one or a few ranks per
+// node.  AML is single-threaded, so visits are not Active Messages: OpenMP
+// threads scan the frontier and bin the visits by owner, the master thread
+// exchanges them with MPI_Alltoallv, and the threads apply the received ones
+// with atomic fetch-or on the visited bitmap.
+
+#include "common.h"
+#include "aml.h"
+#include "csr_reference.h"
+#include "bitmap_reference.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <stdint.h>
+#include <omp.h>
+
+// Most visits a rank sends in one exchange; a level with more frontier edges
+// takes several rounds, which bounds the message buffers
+#ifndef HYBRID_BFS_BATCH
+#define HYBRID_BFS_BATCH (1 << 22)
+#endif
+// Next-frontier entries a thread collects before reserving room in q2
+#define HYBRID_QUEUE_CHUNK 256
+
+// two arrays holding visited VERTEX_LOCALs for current and next level
+// we swap pointers each time
+int *q1,*q2;
+int qc,q2c; //pointer to first free element
+
+//VISITED bitmap parameters
+unsigned long *visited;
+int64_t visited_size;
+
+//global variables of CSR graph
+int64_t *column;
+int64_t *pred_glob;
+unsigned int * rowstarts;
+
+oned_csr_graph g;
+
+typedef struct visitmsg {
+	//both vertexes are VERTEX_LOCAL components as we know src and dest PEs to reconstruct VERTEX_GLOBAL
+	int vloc;
+	int vfrom;
+} visitmsg;
+
+// per-thread, per-destination message counts and the exchange buffers
+static int nthreads;
+static int *thread_counts;
+static int *sendcounts,*sdispls,*recvcounts,*rdispls;
+static visitmsg *sendbuf,*recvbuf;
+static size_t sendbuf_size,recvbuf_size;
+static MPI_Datatype visitmsg_type; //sizeof(visitmsg) bytes
+
+void make_graph_data_structure(const tuple_graph* const tg) {
+	int i;
+	convert_graph_to_oned_csr(tg, &g);
+	column=g.column;
+	rowstarts=g.rowstarts;
+
+	visited_size = (g.nlocalverts + ulong_bits - 1) / ulong_bits;
+	q1 = xmalloc(g.nlocalverts*sizeof(int)); //100% of vertexes
+	q2 = xmalloc(g.nlocalverts*sizeof(int));
+	#pragma omp parallel for schedule(static)
+	for(i=0;i<g.nlocalverts;i++) q1[i]=0,q2[i]=0; //touch memory
+	visited = xmalloc(visited_size*sizeof(unsigned long));
+
+	nthreads = omp_get_max_threads();
+	thread_counts = xmalloc((size_t)nthreads*num_pes()*sizeof(int));
+	sendcounts = xmalloc(num_pes()*sizeof(int));
+	sdispls = xmalloc((num_pes()+1)*sizeof(int));
+	recvcounts = xmalloc(num_pes()*sizeof(int));
+	rdispls = xmalloc((num_pes()+1)*sizeof(int));
+	sendbuf = NULL; sendbuf_size = 0;
+	recvbuf = NULL; recvbuf_size = 0;
+	MPI_Type_contiguous(sizeof(visitmsg),MPI_BYTE,&visitmsg_type);
+	MPI_Type_commit(&visitmsg_type);
+}
+
+// mark local vertex vloc visited with parent pred; returns 1 for the one
+// thread that visits it first
+static inline int visit(int vloc, int64_t pred) {
+	unsigned long bit = 1UL << (vloc ulong_mask);
+	unsigned long* word = &visited[vloc ulong_shift];
+	if (__atomic_load_n(word, __ATOMIC_RELAXED) & bit) return 0;
+	if (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit) return 0;
+	pred_glob[vloc] = pred;
+	return 1;
+}
+
+static inline void push_next(int* buf, int* n) {
+	int pos = __atomic_fetch_add(&q2c, *n, __ATOMIC_RELAXED);
+	memcpy(q2 + pos, buf, *n * sizeof(int));
+	*n = 0;
+}
+
+// send visits from the frontier vertices q1[first, last) and apply the
+// visits received by this rank
+static void exchange_round(int first, int last) {
+	int p,t,np=num_pes();
+	memset(thread_counts,0,(size_t)nthreads*np*sizeof(int));
+
+	// count, then place each thread's messages per destination, destination
+	// major so every destination's messages are contiguous
+	#pragma omp parallel
+	{
+		int* cnt = thread_counts + (size_t)omp_get_thread_num()*np;
+		int i;
+		unsigned int j;
+		#pragma omp for schedule(static)
+		for(i=first;i<last;i++)
+			for(j=rowstarts[q1[i]];j<rowstarts[q1[i]+1];j++)
+				cnt[VERTEX_OWNER(COLUMN(j))]++;
+		#pragma omp single
+		{
+			int pos=0;
+			for(p=0;p<np;p++) {
+				sdispls[p]=pos;
+				for(t=0;t<nthreads;t++) {
+					int c=thread_counts[(size_t)t*np+p];
+					thread_counts[(size_t)t*np+p]=pos;
+					pos+=c;
+				}
+				sendcounts[p]=pos-sdispls[p];
+			}
+			sdispls[np]=pos;
+			if((size_t)pos>sendbuf_size) {
+				free(sendbuf);
+				sendbuf_size=pos;
+				sendbuf=xmalloc(sendbuf_size*sizeof(visitmsg));
+			}
+		}
+		#pragma omp for schedule(static)
+		for(i=first;i<last;i++)
+			for(j=rowstarts[q1[i]];j<rowstarts[q1[i]+1];j++) {
+				int64_t v=COLUMN(j);
+				visitmsg m = {VERTEX_LOCAL(v),q1[i]};
+				sendbuf[cnt[VERTEX_OWNER(v)]++]=m;
+			}
+	}
+
+	MPI_Alltoall(sendcounts,1,MPI_INT,recvcounts,1,MPI_INT,MPI_COMM_WORLD);
+	rdispls[0]=0;
+	for(p=0;p<np;p++) rdispls[p+1]=rdispls[p]+recvcounts[p];
+	if((size_t)rdispls[np]>recvbuf_size) {
+		free(recvbuf);
+		recvbuf_size=rdispls[np];
+		recvbuf=xmalloc(recvbuf_size*sizeof(visitmsg));
+	}
+	MPI_Alltoallv(sendbuf,sendcounts,sdispls,visitmsg_type,recvbuf,recvcounts,rdispls,visitmsg_type,MPI_COMM_WORLD);
+
+	#pragma omp parallel
+	{
+		int next[HYBRID_QUEUE_CHUNK];
+		int n=0;
+		// contiguous share of the received messages, sender found by binary
+		// search on rdispls and then advanced while scanning
+		int nt=omp_get_num_threads(),tid=omp_get_thread_num();
+		int k=(int)((long)rdispls[np]*tid/nt),end=(int)((long)rdispls[np]*(tid+1)/nt);
+		int lo=0,hi=np;
+		while(hi-lo>1) { int mid=(lo+hi)/2; if(rdispls[mid]<=k) lo=mid; else hi=mid; }
+		int from=lo;
+		for(;k<end;k++) {
+			while(k>=rdispls[from+1]) from++;
+			if(visit(recvbuf[k].vloc,VERTEX_TO_GLOBAL(from,recvbuf[k].vfrom))) {
+				next[n++]=recvbuf[k].vloc;
+				if(n==HYBRID_QUEUE_CHUNK) push_next(next,&n);
+			}
+		}
+		if(n) push_next(next,&n);
+	}
+}
+
+void run_bfs(int64_t root, int64_t* pred) {
+	int64_t nvisited;
+	long sum;
+	pred_glob=pred;
+
+	CLEAN_VISITED();
+
+	qc=0; sum=1; q2c=0;
+
+	nvisited=1;
+	if(VERTEX_OWNER(root) == rank) {
+		pred[VERTEX_LOCAL(root)]=root;
+		SET_VISITED(root);
+		q1[0]=VERTEX_LOCAL(root);
+		qc=1;
+	}
+
+	// While there are vertices in current level
+	while(sum) {
+		// split the frontier into rounds of at most HYBRID_BFS_BATCH edges;
+		// every rank takes part in as many exchanges as the busiest one
+		int first=0;
+		long rounds=0,edges=0;
+		int i;
+		for(i=0;i<qc;i++) {
+			long d=rowstarts[q1[i]+1]-rowstarts[q1[i]];
+			if(edges+d>HYBRID_BFS_BATCH && edges>0) rounds++,edges=0;
+			edges+=d;
+		}
+		if(qc) rounds++;
+		aml_long_allmax(&rounds);
+		long r;
+		for(r=0;r<rounds;r++) {
+			int last=first;
+			edges=0;
+			while(last<qc) {
+				long d=rowstarts[q1[last]+1]-rowstarts[q1[last]];
+				if(edges+d>HYBRID_BFS_BATCH && edges>0) break;
+				edges+=d;
+				last++;
+			}
+			exchange_round(first,last);
+			first=last;
+		}
+
+		qc=q2c;int *tmp=q1;q1=q2;q2=tmp;
+		sum=qc;
+		aml_long_allsum(&sum);
+
+		nvisited+=sum;
+
+		q2c=0;
+	}
+	aml_barrier();
+
+}
+
+//we need edge count to calculate teps. Validation will check if this count is correct
+void get_edge_count_for_teps(int64_t* edge_visit_count) {
+	long i,j;
+	long edge_count=0;
+	#pragma omp parallel for private(j) reduction(+:edge_count) schedule(dynamic,1024)
+	for(i=0;i<g.nlocalverts;i++)
+		if(pred_glob[i]!=-1) {
+			for(j=rowstarts[i];j<rowstarts[i+1];j++)
+				if(COLUMN(j)<=VERTEX_TO_GLOBAL(my_pe(),i))
+					edge_count++;
+
+		}
+
+	aml_long_allsum(&edge_count);
+	*edge_visit_count=edge_count;
+}
+
+void clean_pred(int64_t* pred) {
+	int i;
+	#pragma omp parallel for schedule(static)
+	for(i=0;i<g.nlocalverts;i++) pred[i]=-1;
+}
+void free_graph_data_structure(void) {
+	free_oned_csr_graph(&g);
+	free(q1); free(q2); free(visited);
+	free(thread_counts); free(sendcounts); free(sdispls); free(recvcounts); free(rdispls);
+	free(sendbuf); free(recvbuf);
+	MPI_Type_free(&visitmsg_type);
+}
+
+size_t get_nlocalverts_for_pred(void) {
+	return g.nlocalverts;
+}
@@ -31,9 +31,39 @@ extern int64_t nbytes_sent,nbytes_rcvd;
 int *q1,*q2;
 int qc,q2c; //pointer to first free element
 
-//VISITED bitmap parameters
-unsigned long *visited;
-int64_t visited_size;
+//VISITED epoch stamps, see bitmap_reference.h
+unsigned char *visited_stamp;
+unsigned char visited_epoch;
+
+//local vertices visited by the last run_bfs, in BFS order; while lazy_pred
+//points to its pred array, only these entries differ from -1 there
+int *visited_list;
+int64_t nvisited_list;
+int64_t *lazy_pred;
+
+// Remote vertices this rank already sent a visit to in the current BFS.  The
+// owner visits a vertex by the end of the level the visit was sent in, so any
+// later visit to it from this rank, in the same or a later level, can be
+// dropped: the filter holds for the whole BFS and is only cleared by run_bfs.
+// It is a direct-mapped cache indexed by the low sent_bits bits of the
+// VERTEX_GLOBAL and tagged with the rest plus one (0 is empty); a collision
+// evicts the older vertex, which costs a repeated visit but never loses one.
+// It has a slot per local column entry (a rank never sends more distinct
+// visits), rounded up to a power of two and capped at 2**SCALE, where it is
+// exact, and at SENT_CACHE_SLOTS
+#ifndef SENT_CACHE_SLOTS
+#define SENT_CACHE_SLOTS (1LL << 22)
+#endif
+unsigned int *sent;
+int64_t sent_mask;
+int sent_bits;
+#define SENT_TAG(v) ((unsigned int)((v) >> sent_bits) + 1)
+#define SET_SENT(v) do {sent[(v) & sent_mask] = SENT_TAG(v);} while (0)
+#define TEST_SENT(v) (sent[(v) & sent_mask] == SENT_TAG(v))
+#define CLEAN_SENT() memset(sent,0,(sent_mask+1)*sizeof(unsigned int))
+#ifdef DEBUGSTATS
+long nvisits_sent,nvisits_suppressed;
+#endif
 
 //global variables of CSR graph to be used inside of AM-handlers
 int64_t *column;
@@ -42,25 +72,68 @@ unsigned int * rowstarts;
 
 oned_csr_graph g;
 
-typedef struct visitmsg {
-	//both vertexes are VERTEX_LOCAL components as we know src and dest PEs to reconstruct VERTEX_GLOBAL
-	int vloc;
-	int vfrom;
-} visitmsg;
+// Visits are batched per frontier vertex and destination: one message holds
+// the sender's VERTEX_LOCAL followed by up to VISIT_BATCH target VERTEX_LOCALs,
+// so a vertex with k neighbours on a rank costs 4+4k bytes instead of 8k
+#ifndef VISIT_BATCH
+#define VISIT_BATCH 32
+#endif
+int *batch; //num_pes() slots of 1+VISIT_BATCH ints: vfrom, then vlocs
+int *batchn; //vlocs pending in each slot
+int *touched,ntouched; //destinations with a pending batch
+#ifdef DEBUGSTATS
+long nvisit_bytes;
+#endif
 
 //AM-handler for check&visit
 void visithndl(int from,void* data,int sz) {
-	visitmsg *m = data;
-	if (!TEST_VISITEDLOC(m->vloc)) {
-		SET_VISITEDLOC(m->vloc);
-		q2[q2c++] = m->vloc;
-		pred_glob[m->vloc] = VERTEX_TO_GLOBAL(from,m->vfrom);
+	int *m = data;
+	int64_t vfrom = VERTEX_TO_GLOBAL(from,m[0]);
+	int i,n = sz/sizeof(int);
+	for(i=1;i<n;i++)
+		if (!TEST_VISITED_STAMP(m[i])) {
+			SET_VISITED_STAMP(m[i]);
+			q2[q2c++] = m[i];
+			pred_glob[m[i]] = vfrom;
+		}
+}
+
+static inline void flush_visits(int dest) {
+	int* b = batch+(size_t)dest*(VISIT_BATCH+1);
+#ifdef DEBUGSTATS
+	if(dest != rank) nvisit_bytes += (1+batchn[dest])*sizeof(int)+4; //4: AML header
+#endif
+	aml_send(b,1,(1+batchn[dest])*sizeof(int),dest);
+	batchn[dest]=0;
+}
+
+static inline void send_visit(int64_t glob, int from) {
+	int dest = VERTEX_OWNER(glob);
+	// a remote target needs one message per BFS: once sent it is visited by
+	// the end of this level, later visits from this rank would be dropped
+	if(dest != rank) {
+		if(TEST_SENT(glob)) {
+#ifdef DEBUGSTATS
+			nvisits_suppressed++;
+#endif
+			return;
+		}
+		SET_SENT(glob);
+#ifdef DEBUGSTATS
+		nvisits_sent++;
+#endif
 	}
+	int* b = batch+(size_t)dest*(VISIT_BATCH+1);
+	if(!batchn[dest]) { b[0]=from; touched[ntouched++]=dest; }
+	else if(batchn[dest]==VISIT_BATCH) flush_visits(dest);
+	b[1+batchn[dest]++] = VERTEX_LOCAL(glob);
 }
 
-inline void send_visit(int64_t glob, int from) {
-	visitmsg m = {VERTEX_LOCAL(glob),from};
-	aml_send(&m,1,sizeof(visitmsg),VERTEX_OWNER(glob));
+// send the batches of the current frontier vertex
+static inline void send_visits_done(void) {
+	int i;
+	for(i=0;i<ntouched;i++) flush_visits(touched[i]);
+	ntouched=0;
 }
 
 void make_graph_data_structure(const tuple_graph* const tg) {
@@ -69,12 +142,24 @@ void make_graph_data_structure(const tuple_graph* const tg) {
 	column=g.column;
 	rowstarts=g.rowstarts;
 
-	visited_size = (g.nlocalverts + ulong_bits - 1) / ulong_bits;
 	aml_register_handler(visithndl,1);
 	q1 = xmalloc(g.nlocalverts*sizeof(int)); //100% of vertexes
 	q2 = xmalloc(g.nlocalverts*sizeof(int));
 	for(i=0;i<g.nlocalverts;i++) q1[i]=0,q2[i]=0; //touch memory
-	visited = xmalloc(visited_size*sizeof(unsigned long));
+	visited_stamp = xcalloc(g.nlocalverts,1);
+	visited_epoch = 0;
+	visited_list = xmalloc(g.nlocalverts*sizeof(int));
+	nvisited_list = 0;
+	lazy_pred = NULL;
+	sent_bits = 0;
+	while((1LL << sent_bits) < (int64_t)g.nlocaledges && (1LL << sent_bits) < g.nglobalverts && (1LL << sent_bits) < SENT_CACHE_SLOTS) sent_bits++;
+	while((g.nglobalverts - 1) >> sent_bits >= UINT_MAX) sent_bits++; //tags must fit
+	sent_mask = (1LL << sent_bits) - 1;
+	sent = xcalloc(sent_mask+1,sizeof(unsigned int));
+	batch = xmalloc((size_t)num_pes()*(VISIT_BATCH+1)*sizeof(int));
+	batchn = xcalloc(num_pes(),sizeof(int));
+	touched = xmalloc(num_pes()*sizeof(int));
+	ntouched = 0;
 }
 
 void run_bfs(int64_t root, int64_t* pred) {
@@ -84,16 +169,19 @@ void run_bfs(int64_t root, int64_t* pred) {
 	pred_glob=pred;
 	aml_register_handler(visithndl,1);
 
-	CLEAN_VISITED();
+	NEXT_VISITED_EPOCH();
+	CLEAN_SENT();
+	nvisited_list=0;
 
 	qc=0; sum=1; q2c=0;
 
 	nvisited=1;
 	if(VERTEX_OWNER(root) == rank) {
 		pred[VERTEX_LOCAL(root)]=root;
-		SET_VISITED(root);
+		SET_VISITED_STAMP(VERTEX_LOCAL(root));
 		q1[0]=VERTEX_LOCAL(root);
 		qc=1;
+		visited_list[nvisited_list++]=q1[0];
 	} 
 
 	// While there are vertices in current level
@@ -101,14 +189,19 @@ void run_bfs(int64_t root, int64_t* pred) {
 #ifdef DEBUGSTATS
 		double t0=aml_time();
 		nbytes_sent=0; nbytes_rcvd=0;
+		nvisits_sent=0; nvisits_suppressed=0; nvisit_bytes=0;
 #endif
 		//for all vertices in current level send visit AMs to all neighbours
-		for(i=0;i<qc;i++)
+		for(i=0;i<qc;i++) {
 			for(j=rowstarts[q1[i]];j<rowstarts[q1[i]+1];j++)
 				send_visit(COLUMN(j),q1[i]);
+			send_visits_done();
+		}
 		aml_barrier();
 
 		qc=q2c;int *tmp=q1;q1=q2;q2=tmp;
+		memcpy(visited_list+nvisited_list,q1,qc*sizeof(int));
+		nvisited_list+=qc;
 		sum=qc;
 		aml_long_allsum(&sum);
 
@@ -117,11 +210,15 @@ void run_bfs(int64_t root, int64_t* pred) {
 		q2c=0;
 #ifdef DEBUGSTATS
 		aml_long_allsum(&nbytes_sent);
+		aml_long_allsum(&nvisits_sent);
+		aml_long_allsum(&nvisits_suppressed);
+		aml_long_allsum(&nvisit_bytes);
 		t0-=aml_time();
-		if(!my_pe()) printf (" --lvl%d : %lld(%lld,%3.2f) visited in %5.2fs, network aggr %5.2fGb/s\n",lvl++,sum,nvisited,((double)nvisited/(double)g.notisolated)*100.0,-t0,-(double)nbytes_sent*8.0/(1.e9*t0));
+		if(!my_pe()) printf (" --lvl%d : %lld(%lld,%3.2f) visited in %5.2fs, network aggr %5.2fGb/s, remote visits sent %ld suppressed %ld, %4.2f bytes/visit\n",lvl++,sum,nvisited,((double)nvisited/(double)g.notisolated)*100.0,-t0,-(double)nbytes_sent*8.0/(1.e9*t0),nvisits_sent,nvisits_suppressed,nvisits_sent?(double)nvisit_bytes/nvisits_sent:0.0);
 #endif
 	}
 	aml_barrier();
+	lazy_pred=pred;
 
 }
 
@@ -141,14 +238,20 @@ void get_edge_count_for_teps(int64_t* edge_visit_count) {
 	*edge_visit_count=edge_count;
 }
 
+// after a run_bfs into the same array only its visited vertices need a reset
 void clean_pred(int64_t* pred) {
-	int i;
-	for(i=0;i<g.nlocalverts;i++) pred[i]=-1;
+	int64_t i;
+	if(pred==lazy_pred)
+		for(i=0;i<nvisited_list;i++) pred[visited_list[i]]=-1;
+	else
+		for(i=0;i<g.nlocalverts;i++) pred[i]=-1;
+	lazy_pred=NULL;
 }
 void free_graph_data_structure(void) {
 	int i; 
 	free_oned_csr_graph(&g);
-	free(q1); free(q2); free(visited);
+	free(q1); free(q2); free(visited_stamp); free(visited_list); free(sent);
+	free(batch); free(batchn); free(touched);
 }
 
 size_t get_nlocalverts_for_pred(void) {
@@ -16,3 +16,10 @@
 #define TEST_VISITED(v) ((visited[VERTEX_LOCAL((v)) ulong_shift] & (1UL << (VERTEX_LOCAL((v)) ulong_mask))) != 0)
 #define TEST_VISITEDLOC(v) ((visited[(v) ulong_shift] & (1ULL << ((v) ulong_mask))) != 0)
 #define CLEAN_VISITED()  memset(visited,0,visited_size*sizeof(unsigned long));
+
+// Epoch-stamped visited set indexed by VERTEX_LOCAL: a vertex is visited when
+// its byte equals visited_epoch, so a new traversal only bumps the epoch and
+// the stamps are wiped once every 255 traversals when it wraps
+#define SET_VISITED_STAMP(v) do {visited_stamp[(v)] = visited_epoch;} while (0)
+#define TEST_VISITED_STAMP(v) (visited_stamp[(v)] == visited_epoch)
+#define NEXT_VISITED_EPOCH() do {if(!++visited_epoch) {memset(visited_stamp,0,g.nlocalverts); visited_epoch=1;}} while (0)
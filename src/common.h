@@ -250,14 +250,15 @@ typedef struct tuple_graph {
 							return a < b ? a : b;
 						}
 
+						static inline int64_t int64_max(int64_t a, int64_t b) {
+							return a > b ? a : b;
+						}
+
 						/* Chunk size for blocks of one-sided operations; a fence is inserted after (at
 						 * most) each CHUNKSIZE one-sided operations. */
 #define CHUNKSIZE (1 << 22)
 #define HALF_CHUNKSIZE ((CHUNKSIZE) / 2)
 
-						/* Bitmap size (in bytes) to keep for each node when determining BFS roots. */
-#define BITMAPSIZE (1UL << 29)
-
 #ifdef __cplusplus
 					}
 #endif
@@ -21,6 +21,10 @@
 #include <stdio.h>
 #include <assert.h>
 #include <search.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 int64_t nverts_known = 0;
 int *degrees;
@@ -72,8 +76,142 @@ void send_full_edge (int64_t src,int64_t tgt) {
 }
 #endif
 
+/* Checkpoint file of one rank: this header in the first page, then rowstarts,
+ * column and weights, each starting on a page so the file can be mapped.  The
+ * column section has 8 bytes of slack for COLUMN() reading past its last
+ * entry. */
+#define CSR_CHECKPOINT_MAGIC "G500CSR1"
+#define CSR_CHECKPOINT_PAGE 4096
+typedef struct csr_checkpoint_header {
+	char magic[8];
+	csr_checkpoint_key key;
+	int32_t nranks, rank, sssp, bytes_per_vertex;
+	uint64_t nlocalverts, nlocaledges;
+	int64_t lg_nglobalverts, nglobalverts, notisolated;
+	uint64_t rowstarts_offset, column_offset, weights_offset, file_size;
+} csr_checkpoint_header;
+
+static char* checkpoint_path = NULL; /* path.<rank> */
+static csr_checkpoint_key checkpoint_key;
+static int checkpoint_valid = 0;
+
+static uint64_t page_round(uint64_t n) {
+	return (n + CSR_CHECKPOINT_PAGE - 1) / CSR_CHECKPOINT_PAGE * CSR_CHECKPOINT_PAGE;
+}
+
+int csr_checkpoint_open(const char* path, const csr_checkpoint_key* key) {
+	free(checkpoint_path);
+	checkpoint_path = xmalloc(strlen(path) + 16);
+	sprintf(checkpoint_path, "%s.%d", path, my_pe());
+	checkpoint_key = *key;
+
+	long valid = 0;
+	csr_checkpoint_header h;
+	struct stat st;
+	int fd = open(checkpoint_path, O_RDONLY);
+	if (fd != -1 && read(fd, &h, sizeof(h)) == sizeof(h) && fstat(fd, &st) == 0) {
+		valid = !memcmp(h.magic, CSR_CHECKPOINT_MAGIC, 8) && !memcmp(&h.key, key, sizeof(*key)) &&
+			h.nranks == num_pes() && h.rank == my_pe() && h.bytes_per_vertex == BYTES_PER_VERTEX &&
+#ifdef SSSP
+			h.sssp &&
+#endif
+			h.file_size == (uint64_t)st.st_size;
+	}
+	if (fd != -1) close(fd);
+	aml_long_allmin(&valid);
+	checkpoint_valid = (int)valid;
+	return checkpoint_valid;
+}
+
+static void map_oned_csr_checkpoint(oned_csr_graph* const g) {
+	int fd = open(checkpoint_path, O_RDONLY);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "%d: cannot open checkpoint %s\n", my_pe(), checkpoint_path);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	/* Private, so the BFS code may still write to the arrays. */
+	char* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "%d: cannot map checkpoint %s\n", my_pe(), checkpoint_path);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	const csr_checkpoint_header* h = (const csr_checkpoint_header*)p;
+	g->mapping = p;
+	g->mapping_size = st.st_size;
+	g->nlocalverts = h->nlocalverts;
+	g->nlocaledges = h->nlocaledges;
+	g->lg_nglobalverts = (int)h->lg_nglobalverts;
+	g->nglobalverts = h->nglobalverts;
+	g->notisolated = h->notisolated;
+	g->rowstarts = (unsigned int*)(p + h->rowstarts_offset);
+	g->column = column = (int64_t*)(p + h->column_offset);
+#ifdef SSSP
+	g->weights = weights = (float*)(p + h->weights_offset);
+#endif
+}
+
+/* Write this rank's graph to its checkpoint file, under a temporary name that
+ * is renamed at the end; a failure only costs the checkpoint. */
+static void save_oned_csr_checkpoint(const oned_csr_graph* const g) {
+	csr_checkpoint_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CSR_CHECKPOINT_MAGIC, 8);
+	h.key = checkpoint_key;
+	h.nranks = num_pes();
+	h.rank = my_pe();
+#ifdef SSSP
+	h.sssp = 1;
+#endif
+	h.bytes_per_vertex = BYTES_PER_VERTEX;
+	h.nlocalverts = g->nlocalverts;
+	h.nlocaledges = g->nlocaledges;
+	h.lg_nglobalverts = g->lg_nglobalverts;
+	h.nglobalverts = g->nglobalverts;
+	h.notisolated = g->notisolated;
+	h.rowstarts_offset = CSR_CHECKPOINT_PAGE;
+	h.column_offset = h.rowstarts_offset + page_round((g->nlocalverts + 1) * sizeof(unsigned int));
+	h.weights_offset = h.column_offset + page_round((uint64_t)BYTES_PER_VERTEX * g->nlocaledges + 8);
+	h.file_size = h.weights_offset;
+#ifdef SSSP
+	h.file_size += sizeof(float) * g->nlocaledges;
+#endif
+
+	char* tmp = xmalloc(strlen(checkpoint_path) + 8);
+	sprintf(tmp, "%s.tmp", checkpoint_path);
+	FILE* f = fopen(tmp, "wb");
+	int ok = f != NULL;
+	char page[CSR_CHECKPOINT_PAGE];
+	memset(page, 0, sizeof(page));
+	memcpy(page, &h, sizeof(h));
+	ok = ok && fwrite(page, 1, sizeof(page), f) == sizeof(page);
+	ok = ok && fwrite(g->rowstarts, sizeof(unsigned int), g->nlocalverts + 1, f) == g->nlocalverts + 1;
+	ok = ok && fseek(f, h.column_offset, SEEK_SET) == 0;
+	ok = ok && fwrite(g->column, BYTES_PER_VERTEX, g->nlocaledges, f) == g->nlocaledges;
+#ifdef SSSP
+	ok = ok && fseek(f, h.weights_offset, SEEK_SET) == 0;
+	ok = ok && fwrite(g->weights, sizeof(float), g->nlocaledges, f) == g->nlocaledges;
+#endif
+	if (f != NULL) ok = (fclose(f) == 0) && ok;
+	ok = ok && truncate(tmp, h.file_size) == 0 && rename(tmp, checkpoint_path) == 0;
+	if (!ok) {
+		fprintf(stderr, "%d: cannot write checkpoint %s\n", my_pe(), checkpoint_path);
+		unlink(tmp);
+	}
+	free(tmp);
+}
+
 void convert_graph_to_oned_csr(const tuple_graph* const tg, oned_csr_graph* const g) {
 	g->tg = tg;
+	g->mapping = NULL;
+	g->mapping_size = 0;
+	if (checkpoint_valid) {
+		map_oned_csr_checkpoint(g);
+		checkpoint_valid = 0;
+		aml_barrier();
+		return;
+	}
 
 	size_t i,j,k;
 
@@ -177,9 +315,20 @@ void convert_graph_to_oned_csr(const tuple_graph* const tg, oned_csr_graph* cons
 	} ITERATE_TUPLE_GRAPH_END;
 
 	free(degrees);
+	if (checkpoint_path != NULL) save_oned_csr_checkpoint(g);
 }
 
 void free_oned_csr_graph(oned_csr_graph* const g) {
+	if (g->mapping != NULL) {
+		munmap(g->mapping, g->mapping_size);
+		g->mapping = NULL;
+		g->rowstarts = NULL;
+		g->column = NULL;
+#ifdef SSSP
+		g->weights = NULL;
+#endif
+		return;
+	}
 	if (g->rowstarts != NULL) {free(g->rowstarts); g->rowstarts = NULL;}
 	if (g->column != NULL) {free(g->column); g->column = NULL;}
 #ifdef SSSP
@@ -24,8 +24,25 @@ typedef struct oned_csr_graph {
 	float *weights;
 #endif
 	const tuple_graph* tg;
+	void* mapping; /* Checkpoint file mapped by convert_graph_to_oned_csr, or NULL */
+	size_t mapping_size;
 } oned_csr_graph;
 
+/* What a CSR checkpoint was built from; a checkpoint is only used for the
+ * same graph and rank count. */
+typedef struct csr_checkpoint_key {
+	int64_t scale, edgefactor;
+	uint64_t seed1, seed2;
+	int64_t initiator[4]; /* a, b, c and noise, in 1/KRONECKER_INITIATOR_DENOMINATOR */
+	uint64_t source; /* 0 if generated, else a hash of the edge file pattern and the files' sizes and mtimes */
+} csr_checkpoint_key;
+
+/* Collective.  Use the per-rank checkpoint files path.<rank> for the next
+ * convert_graph_to_oned_csr: returns 1 if every rank has one matching key,
+ * which is then mapped instead of building the graph; otherwise the graph is
+ * built from the edges and saved to them. */
+int csr_checkpoint_open(const char* path, const csr_checkpoint_key* key);
+
 void convert_graph_to_oned_csr(const tuple_graph* const tg, oned_csr_graph* const g);
 void free_oned_csr_graph(oned_csr_graph* const g);
 
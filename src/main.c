@@ -21,6 +21,7 @@
 #include "../generator/utils.h"
 #include "aml.h"
 #include "common.h"
+#include "csr_reference.h"
 #include <math.h>
 #include <assert.h>
 #include <string.h>
@@ -30,6 +31,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <sys/stat.h>
 
 int isisolated(int64_t v);
 static int compare_doubles(const void* a, const void* b) {
@@ -67,6 +69,205 @@ void get_statistics(const double x[], int n, volatile double r[s_LAST]) {
 	free(xx);
 }
 
+/* Open file number i of a printf-style path pattern (at most one integer
+ * conversion, e.g. "block-%02d.bin") for reading, or return MPI_FILE_NULL. */
+static MPI_File open_block_file(const char* pattern, int i, MPI_Offset* size) {
+	char path[4096];
+	MPI_File f;
+	snprintf(path, sizeof(path), pattern, i);
+	MPI_File_set_errhandler(MPI_FILE_NULL, MPI_ERRORS_RETURN);
+	int err = MPI_File_open(MPI_COMM_SELF, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &f);
+	MPI_File_set_errhandler(MPI_FILE_NULL, MPI_ERRORS_ARE_FATAL);
+	if (err != MPI_SUCCESS) {
+		fprintf(stderr, "%d: cannot open %s\n", rank, path);
+		return MPI_FILE_NULL;
+	}
+	MPI_File_get_size(f, size);
+	return f;
+}
+
+/* FNV-1a of nbytes of data, continuing from h. */
+static uint64_t fnv1a(uint64_t h, const void* data, size_t nbytes) {
+	const unsigned char* c = (const unsigned char*)data;
+	size_t i;
+	for (i = 0; i < nbytes; ++i) h = (h ^ c[i]) * 1099511628211ULL;
+	return h;
+}
+
+/* Add the size and modification time of the files load_edge_files reads
+ * (edge files until nglobaledges edges of edge_bytes bytes are covered, and
+ * the weights files with the same numbers) to h, so edge files regenerated in
+ * place do not match an old CSR checkpoint. */
+static uint64_t hash_edge_files(uint64_t h, const char* pattern, const char* weight_pattern, int64_t nglobaledges, int edge_bytes) {
+	char path[4096];
+	struct stat st;
+	int64_t nedges = 0;
+	int i;
+	for (i = 0; nedges < nglobaledges; ++i) {
+		snprintf(path, sizeof(path), pattern, i);
+		if (stat(path, &st) != 0 || st.st_size < edge_bytes) break; /* load_edge_files reports it */
+		nedges += st.st_size / edge_bytes;
+		h = fnv1a(h, &st.st_size, sizeof(st.st_size));
+		h = fnv1a(h, &st.st_mtim, sizeof(st.st_mtim));
+		if (weight_pattern) {
+			snprintf(path, sizeof(path), weight_pattern, i);
+			if (stat(path, &st) != 0) break;
+			h = fnv1a(h, &st.st_size, sizeof(st.st_size));
+			h = fnv1a(h, &st.st_mtim, sizeof(st.st_mtim));
+		}
+	}
+	return h;
+}
+
+/* Fill tg->edgememory (and tg->weightmemory) from the binary edge files of
+ * generator_omp: pairs of vertices of vertex_bits bits, one file per block
+ * numbered from 0, and optionally weights files with the same numbers holding
+ * floats (-w 1) or 16-bit round(w * 65535) (-w 2).  The files must add up to
+ * tg->nglobaledges edges; rank r reads edges [r * n / size, (r + 1) * n /
+ * size) of their concatenation, so every rank reads in parallel and the
+ * blocks need not match the ranks. */
+static void load_edge_files(tuple_graph* tg, int SCALE, const char* pattern, int vertex_bits, const char* weight_pattern) {
+	const int64_t nglobalverts = (int64_t)1 << SCALE;
+	const MPI_Offset edge_bytes = 2 * vertex_bits / CHAR_BIT;
+	int64_t my_start = tg->nglobaledges / size * rank + int64_min(rank, tg->nglobaledges % size);
+	int64_t my_end = my_start + tg->nglobaledges / size + (rank < tg->nglobaledges % size);
+
+	tg->data_in_file = 0;
+	tg->edgememory_size = my_end - my_start;
+	tg->edgememory = (packed_edge*)xmalloc(tg->edgememory_size * sizeof(packed_edge));
+#ifdef SSSP
+	tg->weightmemory = (float*)xmalloc(tg->edgememory_size * sizeof(float));
+#endif
+	void* buf = xmalloc(FILE_CHUNKSIZE * edge_bytes);
+	int bad = 0;
+
+	int64_t file_start = 0; /* First edge of file i */
+	int i;
+	for (i = 0; file_start < tg->nglobaledges && !bad; ++i) {
+		MPI_Offset fsize;
+		MPI_File f = open_block_file(pattern, i, &fsize);
+		if (f == MPI_FILE_NULL || fsize % edge_bytes != 0 || fsize == 0) {
+			if (f != MPI_FILE_NULL) fprintf(stderr, "%d: size of edge file %d is not a multiple of %d bytes\n", rank, i, (int)edge_bytes);
+			bad = 1;
+			if (f != MPI_FILE_NULL) MPI_File_close(&f);
+			break;
+		}
+		int64_t file_end = file_start + fsize / edge_bytes;
+		int64_t start = int64_max(file_start, my_start), end = int64_min(file_end, my_end);
+		if (start < end) {
+#ifdef SSSP
+			MPI_Offset wsize = 0;
+			int weight_bytes = 0;
+			MPI_File wf = open_block_file(weight_pattern, i, &wsize);
+			if (wf != MPI_FILE_NULL) weight_bytes = (int)(wsize / (file_end - file_start));
+			if (wf == MPI_FILE_NULL || (weight_bytes != 4 && weight_bytes != 2) || wsize != weight_bytes * (file_end - file_start)) {
+				if (wf != MPI_FILE_NULL) fprintf(stderr, "%d: weights file %d does not match edge file\n", rank, i);
+				bad = 1;
+			}
+#else
+			(void)weight_pattern;
+#endif
+			int64_t pos;
+			for (pos = start; pos < end && !bad; pos += FILE_CHUNKSIZE) {
+				int count = (int)int64_min(FILE_CHUNKSIZE, end - pos);
+				packed_edge* out = tg->edgememory + (pos - my_start);
+				MPI_Offset off = (pos - file_start) * edge_bytes;
+				int64_t j;
+				if (vertex_bits == 32) {
+					const uint32_t* v = (const uint32_t*)buf;
+					MPI_File_read_at(f, off, buf, 2 * count, MPI_UINT32_T, MPI_STATUS_IGNORE);
+					for (j = 0; j < count; ++j) {
+						bad |= v[2 * j] >= nglobalverts || v[2 * j + 1] >= nglobalverts;
+						write_edge(&out[j], v[2 * j], v[2 * j + 1]);
+					}
+				} else {
+					const int64_t* v = (const int64_t*)buf;
+					MPI_File_read_at(f, off, buf, 2 * count, MPI_INT64_T, MPI_STATUS_IGNORE);
+					for (j = 0; j < count; ++j) {
+						bad |= v[2 * j] < 0 || v[2 * j] >= nglobalverts || v[2 * j + 1] < 0 || v[2 * j + 1] >= nglobalverts;
+						write_edge(&out[j], v[2 * j], v[2 * j + 1]);
+					}
+				}
+				if (bad) fprintf(stderr, "%d: vertex out of range for SCALE %d in edge file %d\n", rank, SCALE, i);
+#ifdef SSSP
+				float* w = tg->weightmemory + (pos - my_start);
+				if (weight_bytes == 4) {
+					MPI_File_read_at(wf, (pos - file_start) * 4, w, count, MPI_FLOAT, MPI_STATUS_IGNORE);
+				} else if (weight_bytes == 2) {
+					const uint16_t* q = (const uint16_t*)buf;
+					MPI_File_read_at(wf, (pos - file_start) * 2, buf, count, MPI_UINT16_T, MPI_STATUS_IGNORE);
+					for (j = 0; j < count; ++j) w[j] = q[j] / 65535.f;
+				}
+#endif
+			}
+#ifdef SSSP
+			if (wf != MPI_FILE_NULL) MPI_File_close(&wf);
+#endif
+		}
+		MPI_File_close(&f);
+		file_start = file_end;
+	}
+	free(buf);
+	if (!bad && file_start != tg->nglobaledges) {
+		if (rank == 0) fprintf(stderr, "Edge files hold %" PRId64 " edges, SCALE %d needs %" PRId64 "\n", file_start, SCALE, tg->nglobaledges);
+		bad = 1;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &bad, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+	if (bad) MPI_Abort(MPI_COMM_WORLD, 1);
+	MPI_Allreduce(&tg->edgememory_size, &tg->max_edgememory_size, 1, MPI_INT64_T, MPI_MAX, MPI_COMM_WORLD);
+}
+
+/* Pick num_bfs_roots distinct non-isolated vertices as BFS roots.  Candidate
+ * k is (d[2k] + d[2k+1]) * nglobalverts of the random stream, as in the
+ * reference code; once 2 * nglobalverts values are used up, the next
+ * candidate is taken as is.  Candidates are drawn and tested ROOT_BATCH at a
+ * time, with a single allreduce of their isolated flags per batch instead of
+ * one per candidate, and then accepted or skipped in order, so the roots are
+ * the same as testing them one by one.  Returns the number of roots. */
+#define ROOT_BATCH 128
+static int select_bfs_roots(int num_bfs_roots, int64_t* bfs_roots, uint64_t seed1, uint64_t seed2, int64_t nglobalverts) {
+	double d[2 * ROOT_BATCH];
+	int64_t candidates[ROOT_BATCH];
+	int root_bad[ROOT_BATCH];
+	uint64_t counter = 0;
+	int nleft = 0, next = 0; /* Untested candidates left in the batch */
+	int bfs_root_idx;
+	for (bfs_root_idx = 0; bfs_root_idx < num_bfs_roots; ++bfs_root_idx) {
+		int64_t root;
+		while (1) {
+			if (nleft == 0) {
+				int i;
+				make_random_numbers(2 * ROOT_BATCH, seed1, seed2, counter, d);
+				for (i = 0; i < ROOT_BATCH; ++i) {
+					candidates[i] = (int64_t)((d[2 * i] + d[2 * i + 1]) * nglobalverts) % nglobalverts;
+					root_bad[i] = isisolated(candidates[i]);
+				}
+				MPI_Allreduce(MPI_IN_PLACE, root_bad, ROOT_BATCH, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+				nleft = ROOT_BATCH;
+				next = 0;
+			}
+			root = candidates[next];
+			int bad = root_bad[next];
+			++next;
+			--nleft;
+			counter += 2;
+			if (counter > 2 * nglobalverts) break;
+			int is_duplicate = 0;
+			int i;
+			for (i = 0; i < bfs_root_idx; ++i) {
+				if (root == bfs_roots[i]) {
+					is_duplicate = 1;
+					break;
+				}
+			}
+			if (is_duplicate) continue; /* Everyone takes the same path here */
+			if (!bad) break;
+		}
+		bfs_roots[bfs_root_idx] = root;
+	}
+	return bfs_root_idx;
+}
+
 int main(int argc, char** argv) {
 	aml_init(&argc,&argv); //includes MPI_Init inside
 	setup_globals();
@@ -78,12 +279,34 @@ int main(int argc, char** argv) {
 	if (argc >= 3) edgefactor = atoi(argv[2]);
 	if (argc <= 1 || argc >= 4 || SCALE == 0 || edgefactor == 0) {
 		if (rank == 0) {
-			fprintf(stderr, "Usage: %s SCALE edgefactor\n  SCALE = log_2(# vertices) [integer, required]\n  edgefactor = (# edges) / (# vertices) = .5 * (average vertex degree) [integer, defaults to 16]\n(Random number seed and Kronecker initiator are in main.c)\n", argv[0]);
+			fprintf(stderr, "Usage: %s SCALE edgefactor\n  SCALE = log_2(# vertices) [integer, required]\n  edgefactor = (# edges) / (# vertices) = .5 * (average vertex degree) [integer, defaults to 16]\n(Random number seed is in main.c; set INITIATOR=a,b,c and SPK_NOISE=level to change the Kronecker initiator, or EDGEFILES=pattern to load generator_omp files)\n", argv[0]);
 		}
 		MPI_Abort(MPI_COMM_WORLD, 1);
 	}
 	uint64_t seed1 = 2, seed2 = 3;
 
+	/* Kronecker initiator probabilities a,b,c (d is the rest, b and c may
+	 * differ) and noise level; the default is the specification's. */
+	kronecker_options gen_options;
+	memset(&gen_options, 0, sizeof(gen_options));
+	const char* initiator_env = getenv("INITIATOR");
+	const char* noise_env = getenv("SPK_NOISE");
+	int custom_initiator = initiator_env != NULL || noise_env != NULL;
+	double initiator_a = .57, initiator_b = .19, initiator_c = .19, noise = 0;
+	if ((initiator_env && sscanf(initiator_env, "%lf,%lf,%lf", &initiator_a, &initiator_b, &initiator_c) != 3) ||
+			(noise_env && sscanf(noise_env, "%lf", &noise) != 1)) {
+		if (rank == 0) fprintf(stderr, "INITIATOR must be a,b,c and SPK_NOISE a number\n");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	gen_options.initiator_a = (int)floor(initiator_a * KRONECKER_INITIATOR_DENOMINATOR + .5);
+	gen_options.initiator_b = (int)floor(initiator_b * KRONECKER_INITIATOR_DENOMINATOR + .5);
+	gen_options.initiator_c = (int)floor(initiator_c * KRONECKER_INITIATOR_DENOMINATOR + .5);
+	gen_options.noise_level = (int)floor(noise * KRONECKER_INITIATOR_DENOMINATOR + .5);
+	if (!kronecker_options_valid(&gen_options)) {
+		if (rank == 0) fprintf(stderr, "Invalid INITIATOR or SPK_NOISE: need a + b + c <= 1 and noise <= b, c, (1 - b - c) / 2\n");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
 	const char* filename = getenv("TMPFILE");
 #ifdef SSSP
 	int wmode;
@@ -96,6 +319,56 @@ int main(int argc, char** argv) {
 	const int reuse_file = getenv("REUSEFILE")? 1 : 0;
 	/* If filename is NULL, store data in memory */
 
+	/* Edge files written by generator_omp -f 1, loaded instead of generating
+	 * the graph: EDGEFILES is the path with a printf conversion for the block
+	 * number, EDGEFILE_BITS 64 or 32 (-S), and EDGEFILE_WEIGHTS the weights
+	 * files (-w 1 or -w 2), needed for SSSP. */
+	const char* edgefiles = getenv("EDGEFILES");
+	const char* edgefile_weights = getenv("EDGEFILE_WEIGHTS");
+	const int edgefile_bits = getenv("EDGEFILE_BITS") ? atoi(getenv("EDGEFILE_BITS")) : 64;
+	if (edgefiles && (filename || (edgefile_bits != 32 && edgefile_bits != 64)
+#ifdef SSSP
+				|| !edgefile_weights
+#endif
+				)) {
+		if (rank == 0) fprintf(stderr, "EDGEFILES needs EDGEFILE_BITS=32 or 64, no TMPFILE, and EDGEFILE_WEIGHTS for SSSP\n");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	/* CSRCHECKPOINT=path saves each rank's CSR graph to path.<rank> after
+	 * kernel 1, or maps it from there if it was built from the same graph on
+	 * as many ranks.  The edge list is then only made if validation needs it. */
+	const char* csr_checkpoint = getenv("CSRCHECKPOINT");
+	int csr_from_checkpoint = 0;
+	if (csr_checkpoint) {
+		csr_checkpoint_key key;
+		memset(&key, 0, sizeof(key));
+		key.scale = SCALE;
+		key.edgefactor = edgefactor;
+		key.seed1 = seed1;
+		key.seed2 = seed2;
+		key.initiator[0] = gen_options.initiator_a;
+		key.initiator[1] = gen_options.initiator_b;
+		key.initiator[2] = gen_options.initiator_c;
+		key.initiator[3] = gen_options.noise_level;
+		if (edgefiles) { /* FNV-1a of the pattern, vertex width and file sizes and times */
+			key.source = fnv1a(14695981039346656037ULL ^ (uint64_t)edgefile_bits, edgefiles, strlen(edgefiles));
+#ifdef SSSP
+			key.source = fnv1a(key.source, edgefile_weights, strlen(edgefile_weights));
+			key.source = hash_edge_files(key.source, edgefiles, edgefile_weights, (int64_t)edgefactor << SCALE, 2 * edgefile_bits / CHAR_BIT);
+#else
+			key.source = hash_edge_files(key.source, edgefiles, NULL, (int64_t)edgefactor << SCALE, 2 * edgefile_bits / CHAR_BIT);
+#endif
+		}
+		csr_from_checkpoint = csr_checkpoint_open(csr_checkpoint, &key);
+	}
+#ifdef REUSE_CSR_FOR_VALIDATION
+	const int skip_edges = csr_from_checkpoint;
+#else
+	const int skip_edges = csr_from_checkpoint && getenv("SKIP_VALIDATION");
+#endif
+	if (skip_edges) filename = NULL;
+
 	tuple_graph tg;
 	tg.nglobaledges = (int64_t)(edgefactor) << SCALE;
 	int64_t nglobalverts = (int64_t)(1) << SCALE;
@@ -165,118 +438,79 @@ int main(int argc, char** argv) {
 	int64_t* bfs_roots = (int64_t*)xmalloc(num_bfs_roots * sizeof(int64_t));
 
 	double make_graph_start = MPI_Wtime();
-	if( !tg.data_in_file || tg.write_file )
+	if (skip_edges) {
+		tg.edgememory = NULL;
+		tg.edgememory_size = 0;
+		tg.max_edgememory_size = 0;
+#ifdef SSSP
+		tg.weightmemory = NULL;
+#endif
+	} else if (edgefiles) {
+		load_edge_files(&tg, SCALE, edgefiles, edgefile_bits, edgefile_weights);
+	} else if( !tg.data_in_file || tg.write_file )
 	{
 		/* Spread the two 64-bit numbers into five nonzero values in the correct
 		 * range. */
 		uint_fast32_t seed[5];
 		make_mrg_seed(seed1, seed2, seed);
 
-		/* As the graph is being generated, also keep a bitmap of vertices with
-		 * incident edges.  We keep a grid of processes, each row of which has a
-		 * separate copy of the bitmap (distributed among the processes in the
-		 * row), and then do an allreduce at the end.  This scheme is used to avoid
-		 * non-local communication and reading the file separately just to find BFS
-		 * roots. */
+		/* Block i of FILE_CHUNKSIZE edges is generated once, by rank i % size,
+		 * which keeps it in memory or writes it to the file.  Isolated vertices
+		 * (for choosing BFS roots) are found later from the CSR graph, so no
+		 * rank needs to see the other blocks. */
 		MPI_Offset nchunks_in_file = (tg.nglobaledges + FILE_CHUNKSIZE - 1) / FILE_CHUNKSIZE;
-		int64_t bitmap_size_in_bytes = int64_min(BITMAPSIZE, (nglobalverts + CHAR_BIT - 1) / CHAR_BIT);
-		if (bitmap_size_in_bytes * size * CHAR_BIT < nglobalverts) {
-			bitmap_size_in_bytes = (nglobalverts + size * CHAR_BIT - 1) / (size * CHAR_BIT);
-		}
-		int ranks_per_row = tg.data_in_file ? ((nglobalverts + CHAR_BIT - 1) / CHAR_BIT + bitmap_size_in_bytes - 1) / bitmap_size_in_bytes : 1;
-		int nrows = size / ranks_per_row;
-		int my_row = -1, my_col = -1;
-		MPI_Comm cart_comm;
-		{
-			int dims[2] = {size / ranks_per_row, ranks_per_row};
-			int periods[2] = {0, 0};
-			MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
-		}
-		int in_generating_rectangle = 0;
-		if (cart_comm != MPI_COMM_NULL) {
-			in_generating_rectangle = 1;
-			{
-				int dims[2], periods[2], coords[2];
-				MPI_Cart_get(cart_comm, 2, dims, periods, coords);
-				my_row = coords[0];
-				my_col = coords[1];
-			}
-			MPI_Comm this_col;
-			MPI_Comm_split(cart_comm, my_col, my_row, &this_col);
-			MPI_Comm_free(&cart_comm);
-			/* Every rank in a given row creates the same vertices (for updating the
-			 * bitmap); only one writes them to the file (or final memory buffer). */
-			packed_edge* buf = (packed_edge*)xmalloc(FILE_CHUNKSIZE * sizeof(packed_edge));
+		packed_edge* buf = NULL;
 #ifdef SSSP
-			float* wbuf = (float*)xmalloc(FILE_CHUNKSIZE*sizeof(float));
+		float* wbuf = NULL;
 #endif
-			MPI_Offset block_limit = (nchunks_in_file + nrows - 1) / nrows;
-			/* fprintf(stderr, "%d: nchunks_in_file = %" PRId64 ", block_limit = %" PRId64 " in grid of %d rows, %d cols\n", rank, (int64_t)nchunks_in_file, (int64_t)block_limit, nrows, ranks_per_row); */
-			if (tg.data_in_file) {
-				tg.edgememory_size = 0;
-				tg.edgememory = NULL;
-			} else {
-				int my_pos = my_row + my_col * nrows;
-				int last_pos = (tg.nglobaledges % ((int64_t)FILE_CHUNKSIZE * nrows * ranks_per_row) != 0) ?
-					(tg.nglobaledges / FILE_CHUNKSIZE) % (nrows * ranks_per_row) :
-					-1;
-				int64_t edges_left = tg.nglobaledges % FILE_CHUNKSIZE;
-				int64_t nedges = FILE_CHUNKSIZE * (tg.nglobaledges / ((int64_t)FILE_CHUNKSIZE * nrows * ranks_per_row)) +
-					FILE_CHUNKSIZE * (my_pos < (tg.nglobaledges / FILE_CHUNKSIZE) % (nrows * ranks_per_row)) +
-					(my_pos == last_pos ? edges_left : 0);
-				/* fprintf(stderr, "%d: nedges = %" PRId64 " of %" PRId64 "\n", rank, (int64_t)nedges, (int64_t)tg.nglobaledges); */
-				tg.edgememory_size = nedges;
-				tg.edgememory = (packed_edge*)xmalloc(nedges * sizeof(packed_edge));
+		if (tg.data_in_file) {
+			tg.edgememory_size = 0;
+			tg.edgememory = NULL;
+			buf = (packed_edge*)xmalloc(FILE_CHUNKSIZE * sizeof(packed_edge));
 #ifdef SSSP
-				tg.weightmemory = (float*)xmalloc(nedges*sizeof(float));
+			wbuf = (float*)xmalloc(FILE_CHUNKSIZE*sizeof(float));
 #endif
+		} else {
+			int64_t my_nchunks = rank < nchunks_in_file ? (nchunks_in_file - rank + size - 1) / size : 0;
+			int64_t nedges = FILE_CHUNKSIZE * my_nchunks;
+			if (nchunks_in_file > 0 && (nchunks_in_file - 1) % size == rank) {
+				nedges -= FILE_CHUNKSIZE * nchunks_in_file - tg.nglobaledges; /* Short last block */
 			}
-			MPI_Offset block_idx;
-			for (block_idx = 0; block_idx < block_limit; ++block_idx) {
-				/* fprintf(stderr, "%d: On block %d of %d\n", rank, (int)block_idx, (int)block_limit); */
-				MPI_Offset start_edge_index = int64_min(FILE_CHUNKSIZE * (block_idx * nrows + my_row), tg.nglobaledges);
-				MPI_Offset edge_count = int64_min(tg.nglobaledges - start_edge_index, FILE_CHUNKSIZE);
-				packed_edge* actual_buf = (!tg.data_in_file && block_idx % ranks_per_row == my_col) ?
-					tg.edgememory + FILE_CHUNKSIZE * (block_idx / ranks_per_row) :
-					buf;
+			tg.edgememory_size = nedges;
+			tg.edgememory = (packed_edge*)xmalloc(nedges * sizeof(packed_edge));
 #ifdef SSSP
-				float* actual_wbuf = (!tg.data_in_file && block_idx % ranks_per_row == my_col) ?
-					tg.weightmemory + FILE_CHUNKSIZE * (block_idx / ranks_per_row) :
-					wbuf;
+			tg.weightmemory = (float*)xmalloc(nedges*sizeof(float));
 #endif
-				/* fprintf(stderr, "%d: My range is [%" PRId64 ", %" PRId64 ") %swriting into index %" PRId64 "\n", rank, (int64_t)start_edge_index, (int64_t)(start_edge_index + edge_count), (my_col == (block_idx % ranks_per_row)) ? "" : "not ", (int64_t)(FILE_CHUNKSIZE * (block_idx / ranks_per_row))); */
-				if (!tg.data_in_file && block_idx % ranks_per_row == my_col) {
-					assert (FILE_CHUNKSIZE * (block_idx / ranks_per_row) + edge_count <= tg.edgememory_size);
-				}
-				if (tg.write_file) {
-					generate_kronecker_range(seed, SCALE, start_edge_index, start_edge_index + edge_count, actual_buf
+		}
+		MPI_Offset block_idx;
+		for (block_idx = rank; block_idx < nchunks_in_file; block_idx += size) {
+			MPI_Offset start_edge_index = FILE_CHUNKSIZE * block_idx;
+			MPI_Offset edge_count = int64_min(tg.nglobaledges - start_edge_index, FILE_CHUNKSIZE);
+			packed_edge* actual_buf = tg.data_in_file ? buf : tg.edgememory + FILE_CHUNKSIZE * (block_idx / size);
 #ifdef SSSP
-							,actual_wbuf
+			float* actual_wbuf = tg.data_in_file ? wbuf : tg.weightmemory + FILE_CHUNKSIZE * (block_idx / size);
 #endif
-							);
-					if (tg.data_in_file && my_col == (block_idx % ranks_per_row)) { /* Try to spread writes among ranks */
-						MPI_File_write_at(tg.edgefile, start_edge_index, actual_buf, edge_count, packed_edge_mpi_type, MPI_STATUS_IGNORE);
+			if (!tg.data_in_file) {
+				assert (FILE_CHUNKSIZE * (block_idx / size) + edge_count <= tg.edgememory_size);
+			}
+			generate_kronecker_range_weighted(seed, SCALE, start_edge_index, start_edge_index + edge_count, actual_buf,
 #ifdef SSSP
-						MPI_File_write_at(tg.weightfile, start_edge_index, actual_wbuf, edge_count, MPI_FLOAT, MPI_STATUS_IGNORE);
+					actual_wbuf,
+#else
+					NULL,
 #endif
-					}
-				} else {
-					/* All read rather than syncing up for a row broadcast. */
-					MPI_File_read_at(tg.edgefile, start_edge_index, actual_buf, edge_count, packed_edge_mpi_type, MPI_STATUS_IGNORE);
+					&gen_options);
+			if (tg.data_in_file) {
+				MPI_File_write_at(tg.edgefile, start_edge_index, actual_buf, edge_count, packed_edge_mpi_type, MPI_STATUS_IGNORE);
 #ifdef SSSP
-					MPI_File_read_at(tg.weightfile, start_edge_index, actual_wbuf, edge_count, MPI_FLOAT, MPI_STATUS_IGNORE);
+				MPI_File_write_at(tg.weightfile, start_edge_index, actual_wbuf, edge_count, MPI_FLOAT, MPI_STATUS_IGNORE);
 #endif
-				}
 			}
-			free(buf);
-			MPI_Comm_free(&this_col);
-		} else {
-			tg.edgememory = NULL;
-			tg.edgememory_size = 0;
+		}
+		free(buf);
 #ifdef SSSP
-			tg.weightmemory = NULL;
+		free(wbuf);
 #endif
-		}
 		MPI_Allreduce(&tg.edgememory_size, &tg.max_edgememory_size, 1, MPI_INT64_T, MPI_MAX, MPI_COMM_WORLD);
 		if (tg.data_in_file && tg.write_file) {
 			MPI_File_sync(tg.edgefile);
@@ -302,36 +536,7 @@ int main(int argc, char** argv) {
 	}
 
 	//generate non-isolated roots
-	{
-		uint64_t counter = 0;
-		int bfs_root_idx;
-		for (bfs_root_idx = 0; bfs_root_idx < num_bfs_roots; ++bfs_root_idx) {
-			int64_t root;
-			while (1) {
-				double d[2];
-				make_random_numbers(2, seed1, seed2, counter, d);
-				root = (int64_t)((d[0] + d[1]) * nglobalverts) % nglobalverts;
-				counter += 2;
-				if (counter > 2 * nglobalverts) break;
-				int is_duplicate = 0;
-				int i;
-				for (i = 0; i < bfs_root_idx; ++i) {
-					if (root == bfs_roots[i]) {
-						is_duplicate = 1;
-						break;
-					}
-				}
-				if (is_duplicate) continue; /* Everyone takes the same path here */
-				int root_bad = isisolated(root);
-				MPI_Allreduce(MPI_IN_PLACE, &root_bad, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-				if (!root_bad) break;
-			}
-			bfs_roots[bfs_root_idx] = root;
-		}
-		num_bfs_roots = bfs_root_idx;
-
-
-	}
+	num_bfs_roots = select_bfs_roots(num_bfs_roots, bfs_roots, seed1, seed2, nglobalverts);
 	/* Number of edges visited in each BFS; a double so get_statistics can be
 	 * used directly. */
 	double* edge_counts = (double*)xmalloc(num_bfs_roots * sizeof(double));
@@ -489,6 +694,20 @@ int main(int argc, char** argv) {
 			//for (i = 0; i < num_bfs_roots; ++i) printf(" %g \n",edge_counts[i]);
 			fprintf(stdout, "SCALE:                          %d\n", SCALE);
 			fprintf(stdout, "edgefactor:                     %d\n", edgefactor);
+			if (custom_initiator) {
+				fprintf(stdout, "initiator:                      %g %g %g %g\n",
+						(double)gen_options.initiator_a / KRONECKER_INITIATOR_DENOMINATOR,
+						(double)gen_options.initiator_b / KRONECKER_INITIATOR_DENOMINATOR,
+						(double)gen_options.initiator_c / KRONECKER_INITIATOR_DENOMINATOR,
+						1. - (double)(gen_options.initiator_a + gen_options.initiator_b + gen_options.initiator_c) / KRONECKER_INITIATOR_DENOMINATOR);
+				fprintf(stdout, "noise:                          %g\n", (double)gen_options.noise_level / KRONECKER_INITIATOR_DENOMINATOR);
+			}
+			if (edgefiles) {
+				fprintf(stdout, "edge_files:                     %s\n", edgefiles);
+			}
+			if (csr_from_checkpoint) {
+				fprintf(stdout, "csr_checkpoint:                 %s\n", csr_checkpoint);
+			}
 			fprintf(stdout, "NBFS:                           %d\n", num_bfs_roots);
 			fprintf(stdout, "graph_generation:               %g\n", make_graph_time);
 			fprintf(stdout, "num_mpi_processes:              %d\n", size);
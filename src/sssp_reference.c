@@ -24,8 +24,9 @@ extern oned_csr_graph g;
 extern int qc,q2c;
 extern int* q1,*q2;
 extern int* rowstarts;
-extern int64_t* column,*pred_glob,visited_size;
-extern unsigned long * visited;
+extern int64_t* column,*pred_glob;
+extern unsigned char *visited_stamp,visited_epoch;
+extern int64_t* lazy_pred;
 #ifdef SSSP
 //global variables as those accesed by active message handler
 float *glob_dist;
@@ -51,11 +52,11 @@ void relaxhndl(int from, void* dat, int sz) {
 		*dest_dist = w; //update distance
 		pred_glob[vloc]=VERTEX_TO_GLOBAL(from,m->src_vloc); //update path
 
-		if(lightphase && !TEST_VISITEDLOC(vloc)) //Bitmap used to track if was already relaxed with light edge
+		if(lightphase && !TEST_VISITED_STAMP(vloc)) //Stamps used to track if was already relaxed with light edge
 		{
 			if(w < glob_maxdelta) { //if falls into current bucket needs further reprocessing
 				q2[q2c++] = vloc;
-				SET_VISITEDLOC(vloc);
+				SET_VISITED_STAMP(vloc);
 			}
 		}
 	}
@@ -78,6 +79,7 @@ void run_sssp(int64_t root,int64_t* pred,float *dist) {
 	glob_dist=dist;
 	weights=g.weights;
 	pred_glob=pred;
+	lazy_pred=NULL; //pred entries set here are not tracked, next clean_pred is a full one
 	qc=0;q2c=0;
 
 	aml_register_handler(relaxhndl,1);
@@ -100,7 +102,7 @@ void run_sssp(int64_t root,int64_t* pred,float *dist) {
 #endif
 		//1. iterate over light edges
 		while(sum!=0) {
-			CLEAN_VISITED();
+			NEXT_VISITED_EPOCH();
 			lightphase=1;
 			aml_barrier();
 			for(i=0;i<qc;i++)